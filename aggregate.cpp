@@ -0,0 +1,461 @@
+/*  This file is part of the Vc library.
+
+    Copyright (C) 2016 Matthias Kretz <kretz@kde.org>
+
+    Vc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    Vc is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Vc.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Merges the runs of benchmark-all.sh (and of any number of result directories) into one .dat
+ * file per benchmark binary.
+ *
+ * Files are grouped into series by their name without the "-run<N>" suffix, e.g.
+ * flops_sse-mavx-run1.dat and flops_sse-mavx-run2.dat. Within a series, rows are grouped by their
+ * header and all quoted fields: benchmark.name, benchmark.arch and the extra columns, except for
+ * the extra columns that hold measured values (such as "speedup", cf. -v). Every numeric column is
+ * replaced by the median across the runs, and the bounds of a bootstrap confidence interval of
+ * that median are appended as "<column> CI low/high" columns, together with the number of runs.
+ * The "# key\t: value" metadata block of Version 5 files is carried over, with the distinct values
+ * of the runs joined by " | " where they disagree. Without metadata the output is Version 4.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum {
+    BootstrapSamples = 1000
+};
+
+/// a read-only mapping of a whole file
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &filename)
+    {
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void *map = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                m_data = static_cast<const char *>(map);
+                m_size = info.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile()
+    {
+        if (m_data) {
+            munmap(const_cast<char *>(m_data), m_size);
+        }
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *begin() const { return m_data; }
+    const char *end() const { return m_data + m_size; }
+    bool isValid() const { return m_data != 0; }
+
+private:
+    const char *m_data = 0;
+    std::size_t m_size = 0;
+};
+
+// the extra columns that are measured values rather than parameters of the benchmark
+static std::set<std::string> g_valueColumns = {
+    "\"effective GHz\"", "\"Op/s per core\"", "\"scaling efficiency\"", "\"speedup\"",
+    "\"lane utilization\"", "\"Iterations/s\"", "\"I/O hidden\""};
+
+struct Field
+{
+    const char *begin, *end;
+    bool isString() const { return begin != end && *begin == '"'; }
+    std::string str() const { return std::string(begin, end); }
+    /// parses the field, without the quotes if \p quoted; returns false if it is no number
+    bool number(bool quoted, double &value) const
+    {
+        // strtod needs a terminated string and the mapping is not
+        char buf[64];
+        const char *b = quoted ? begin + 1 : begin;
+        const char *e = quoted && end - begin >= 2 ? end - 1 : end;
+        const std::size_t n = std::min<std::size_t>(e - b, sizeof(buf) - 1);
+        std::memcpy(buf, b, n);
+        buf[n] = '\0';
+        char *parsed;
+        value = std::strtod(buf, &parsed);
+        return n > 0 && *parsed == '\0';
+    }
+};
+
+static void splitLine(const char *begin, const char *end, std::vector<Field> &fields)
+{
+    fields.clear();
+    const char *start = begin;
+    for (const char *it = begin; it != end; ++it) {
+        if (*it == '\t') {
+            fields.push_back({start, it});
+            start = it + 1;
+        }
+    }
+    fields.push_back({start, end});
+}
+
+static bool isStddev(const std::string &name)
+{
+    return name.size() > 8 && name.compare(name.size() - 8, 8, "_stddev\"") == 0;
+}
+
+/// all rows of a series with the same header and the same quoted fields
+struct Group
+{
+    std::size_t header;
+    std::vector<std::string> strings;      // the key fields, indexed like the columns
+    std::vector<std::vector<double>> runs; // the numeric fields, one vector per column
+    std::vector<bool> quoted;              // whether a numeric field is written in quotes
+};
+
+struct Series
+{
+    std::vector<std::vector<std::string>> headers;
+    std::vector<std::vector<bool>> isValueColumn;
+    std::vector<std::vector<bool>> hasInterval; // per header: the columns that get CI columns
+    std::vector<Group> groups;
+    std::unordered_map<std::string, std::size_t> index;
+    std::vector<std::string> metadataKeys; // in the order of the first file
+    std::map<std::string, std::vector<std::string>> metadata; // the distinct values per key
+
+    /// \p line is a "# key\t: value" line of a Version 5 metadata block
+    void addMetadata(const char *line, const char *eol)
+    {
+        const std::string text(line + 2, eol);
+        const std::size_t separator = text.find("\t: ");
+        if (separator == std::string::npos) {
+            return;
+        }
+        const std::string key = text.substr(0, separator);
+        const std::string value = text.substr(separator + 3);
+        auto it = metadata.find(key);
+        if (it == metadata.end()) {
+            metadataKeys.push_back(key);
+            it = metadata.emplace(key, std::vector<std::string>()).first;
+        }
+        if (std::find(it->second.begin(), it->second.end(), value) == it->second.end()) {
+            it->second.push_back(value);
+        }
+    }
+
+    std::size_t addHeader(const std::vector<Field> &fields)
+    {
+        std::vector<std::string> names;
+        for (const Field &f : fields) {
+            names.push_back(f.str());
+        }
+        for (std::size_t i = 0; i < headers.size(); ++i) {
+            if (headers[i] == names) {
+                return i;
+            }
+        }
+        std::vector<bool> values;
+        for (const std::string &n : names) {
+            values.push_back(g_valueColumns.count(n) > 0);
+        }
+        headers.push_back(names);
+        isValueColumn.push_back(values);
+        hasInterval.push_back(std::vector<bool>());
+        return headers.size() - 1;
+    }
+
+    void addRow(std::size_t header, const std::vector<Field> &fields)
+    {
+        if (fields.size() != headers[header].size()) {
+            return;
+        }
+        if (hasInterval[header].empty()) {
+            for (std::size_t i = 0; i < fields.size(); ++i) {
+                hasInterval[header].push_back(
+                    (isValueColumn[header][i] || !fields[i].isString()) && !isStddev(headers[header][i]));
+            }
+        }
+        // a quoted field is part of the key unless it is a number in a value column
+        std::vector<double> numbers(fields.size());
+        std::vector<bool> isKey(fields.size());
+        std::string key = std::to_string(header);
+        for (std::size_t i = 0; i < fields.size(); ++i) {
+            const bool quoted = fields[i].isString();
+            isKey[i] = quoted && !(isValueColumn[header][i] && fields[i].number(true, numbers[i]));
+            if (!quoted) {
+                fields[i].number(false, numbers[i]);
+            } else if (isKey[i]) {
+                key.append(fields[i].begin, fields[i].end);
+            }
+            key += '\t';
+        }
+        auto it = index.find(key);
+        if (it == index.end()) {
+            Group g;
+            g.header = header;
+            g.strings.resize(fields.size());
+            g.runs.resize(fields.size());
+            g.quoted.resize(fields.size());
+            for (std::size_t i = 0; i < fields.size(); ++i) {
+                if (isKey[i]) {
+                    g.strings[i] = fields[i].str();
+                } else {
+                    g.quoted[i] = fields[i].isString();
+                }
+            }
+            it = index.emplace(key, groups.size()).first;
+            groups.push_back(std::move(g));
+        }
+        Group &g = groups[it->second];
+        for (std::size_t i = 0; i < fields.size(); ++i) {
+            if (!isKey[i]) {
+                g.runs[i].push_back(numbers[i]);
+            }
+        }
+    }
+};
+
+/// strips the directory, ".dat" and "-run<N>" from \p filename
+static std::string seriesName(const std::string &filename)
+{
+    std::string name = filename.substr(0, filename.size() - 4);
+    const std::size_t run = name.rfind("-run");
+    if (run != std::string::npos &&
+        name.find_first_not_of("0123456789", run + 4) == std::string::npos && run + 4 < name.size()) {
+        name.erase(run);
+    }
+    return name;
+}
+
+static bool readFile(const std::string &path, Series &series)
+{
+    MappedFile file(path);
+    if (!file.isValid()) {
+        std::cerr << "cannot read " << path << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+    std::vector<Field> fields;
+    std::size_t header = 0;
+    bool haveHeader = false;
+    for (const char *line = file.begin(); line < file.end();) {
+        const char *eol = static_cast<const char *>(std::memchr(line, '\n', file.end() - line));
+        if (!eol) {
+            eol = file.end();
+        }
+        if (eol - line > 2 && line[0] == '#' && line[1] == ' ') {
+            series.addMetadata(line, eol);
+        } else if (eol != line && std::strncmp(line, "Version ", 8) != 0) {
+            splitLine(line, eol, fields);
+            if (fields[0].str() == "\"benchmark.name\"") {
+                header = series.addHeader(fields);
+                haveHeader = true;
+            } else if (haveHeader) {
+                series.addRow(header, fields);
+            }
+        }
+        line = eol + 1;
+    }
+    return true;
+}
+
+static double median(std::vector<double> v)
+{
+    if (v.empty()) {
+        return 0.;
+    }
+    const std::size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    if (v.size() % 2 == 1) {
+        return v[mid];
+    }
+    return (v[mid] + *std::max_element(v.begin(), v.begin() + mid)) * 0.5;
+}
+
+/// the 95% percentile bootstrap confidence interval of the median of \p v
+static std::pair<double, double> bootstrap(const std::vector<double> &v, std::mt19937 &rng)
+{
+    if (v.size() < 2) {
+        const double m = median(v);
+        return {m, m};
+    }
+    std::uniform_int_distribution<std::size_t> pick(0, v.size() - 1);
+    std::vector<double> medians(BootstrapSamples);
+    std::vector<double> resample(v.size());
+    for (double &m : medians) {
+        for (double &x : resample) {
+            x = v[pick(rng)];
+        }
+        m = median(resample);
+    }
+    std::sort(medians.begin(), medians.end());
+    return {medians[BootstrapSamples * 25 / 1000], medians[BootstrapSamples * 975 / 1000]};
+}
+
+static bool writeSeries(const std::string &filename, const Series &series)
+{
+    std::ofstream out(filename.c_str());
+    if (!out) {
+        std::cerr << "cannot write " << filename << '\n';
+        return false;
+    }
+    std::mt19937 rng(1);
+    if (series.metadataKeys.empty()) {
+        out << "Version 4\n";
+    } else {
+        out << "Version 5\n";
+        for (const std::string &key : series.metadataKeys) {
+            const std::vector<std::string> &values = series.metadata.find(key)->second;
+            out << "# " << key << "\t: ";
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                out << (i == 0 ? "" : " | ") << values[i];
+            }
+            out << '\n';
+        }
+    }
+    std::size_t currentHeader = series.headers.size();
+    for (const Group &g : series.groups) {
+        const std::vector<std::string> &names = series.headers[g.header];
+        const std::vector<bool> &interval = series.hasInterval[g.header];
+        if (g.header != currentHeader) {
+            currentHeader = g.header;
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                out << (i == 0 ? "" : "\t") << names[i];
+            }
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                if (!interval[i]) {
+                    continue;
+                }
+                const std::string name = names[i].substr(1, names[i].size() - 2);
+                out << "\t\"" << name << " CI low\"\t\"" << name << " CI high\"";
+            }
+            out << "\t\"runs\"\n";
+        }
+        std::size_t runs = 0;
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            out << (i == 0 ? "" : "\t");
+            if (g.strings[i].empty()) {
+                if (g.quoted[i]) {
+                    out << '"' << median(g.runs[i]) << '"';
+                } else {
+                    out << median(g.runs[i]);
+                }
+                runs = std::max(runs, g.runs[i].size());
+            } else {
+                out << g.strings[i];
+            }
+        }
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            if (!interval[i]) {
+                continue;
+            }
+            if (!g.strings[i].empty()) {
+                // e.g. "-" in a value column
+                out << '\t' << g.strings[i] << '\t' << g.strings[i];
+            } else if (g.quoted[i]) {
+                const std::pair<double, double> ci = bootstrap(g.runs[i], rng);
+                out << "\t\"" << ci.first << "\"\t\"" << ci.second << '"';
+            } else {
+                const std::pair<double, double> ci = bootstrap(g.runs[i], rng);
+                out << '\t' << ci.first << '\t' << ci.second;
+            }
+        }
+        out << '\t' << runs << '\n';
+    }
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    std::cout << "Usage: " << argv0
+              << " [-o <output directory>] [-v <column>]... <result directory>...\n\n"
+              << "Merges the runs of every benchmark in the result directories into one .dat file\n"
+              << "per benchmark with the median of every value and its 95% bootstrap confidence\n"
+              << "interval. The default output directory is \"aggregated\".\n\n"
+              << "  -v <column>  the extra column holds a measured value, not a parameter\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string outputDir = "aggregated";
+    std::vector<std::string> inputDirs;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (std::strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            g_valueColumns.insert('"' + std::string(argv[++i]) + '"');
+        } else if (std::strcmp(argv[i], "-h") == 0 || std::strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else {
+            inputDirs.push_back(argv[i]);
+        }
+    }
+    if (inputDirs.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::map<std::string, Series> allSeries;
+    for (const std::string &dir : inputDirs) {
+        DIR *d = opendir(dir.c_str());
+        if (!d) {
+            std::cerr << "cannot open " << dir << ": " << std::strerror(errno) << '\n';
+            return 1;
+        }
+        while (dirent *entry = readdir(d)) {
+            const std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".dat") == 0) {
+                if (!readFile(dir + '/' + name, allSeries[seriesName(name)])) {
+                    closedir(d);
+                    return 1;
+                }
+            }
+        }
+        closedir(d);
+    }
+
+    if (mkdir(outputDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "cannot create " << outputDir << ": " << std::strerror(errno) << '\n';
+        return 1;
+    }
+    for (const auto &series : allSeries) {
+        if (!writeSeries(outputDir + '/' + series.first + ".dat", series.second)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// vim: sw=4 sts=4 et tw=100
@@ -27,15 +27,54 @@
 using namespace Vc;
 using sfloat_v = Vc::SimdArray<float, short_v::size()>;
 
+/// the type mixed<N> computes in: unsigned wraps around where int and short would overflow
+template <typename V> struct Unsigned { typedef V type; };
+template <> struct Unsigned<int_v> { typedef uint_v type; };
+template <> struct Unsigned<short_v> { typedef ushort_v type; };
+
 template<typename Vector> struct Arithmetics
 {
     typedef typename Vector::EntryType Scalar;
 
+    // Byte/s = Op/s * Byte/Op
+    static std::string bytesPerOp(double x)
+    {
+        std::ostringstream s;
+        s << x;
+        return s.str();
+    }
+
     static void run()
     {
-        const int Factor = CpuId::L1Data() / sizeof(Vector);
+        Benchmark::setColumnData("MemorySize", "half L1");
+        run(CpuId::L1Data() / (sizeof(Vector) * 2), 128);
+        Benchmark::setColumnData("MemorySize", "L1");
+        run(CpuId::L1Data() / (sizeof(Vector) * 1), 128);
+        Benchmark::setColumnData("MemorySize", "half L2");
+        run(CpuId::L2Data() / (sizeof(Vector) * 2), 32);
+        Benchmark::setColumnData("MemorySize", "L2");
+        run(CpuId::L2Data() / (sizeof(Vector) * 1), 16);
+        if (CpuId::L3Data() > 0) {
+            Benchmark::setColumnData("MemorySize", "half L3");
+            run(CpuId::L3Data() / (sizeof(Vector) * 2), 2);
+            Benchmark::setColumnData("MemorySize", "L3");
+            run(CpuId::L3Data() / (sizeof(Vector) * 1), 2);
+            Benchmark::setColumnData("MemorySize", "4x L3");
+            run(CpuId::L3Data() / sizeof(Vector) * 4, 1);
+        } else {
+            Benchmark::setColumnData("MemorySize", "4x L2");
+            run(CpuId::L2Data() / sizeof(Vector) * 4, 1);
+        }
+    }
 
-        const double valuesPerSecondFactor = Factor * Vector::Size;
+    /**
+     * \param Factor The number of vectors in the memory to work on
+     * \param Repetitions How often the memory region should be processed
+     */
+    static void run(int Factor, const int Repetitions)
+    {
+        Factor &= ~7; // the 8x unrolled loops need a multiple of 8
+        const double valuesPerSecondFactor = double(Factor) * Vector::Size * Repetitions;
 
         Vector *data = new Vector[Factor + 1];
 #ifndef VC_BENCHMARK_NO_MLOCK
@@ -46,167 +85,263 @@ template<typename Vector> struct Arithmetics
             data[i](data[i] == Vector(Zero)) += Vector(One);
         }
 
+        // every result needs one new vector from memory
+        Benchmark::setColumnData("Byte/Op", bytesPerOp(sizeof(Scalar)));
         Benchmark::setColumnData("unrolling", "not unrolled");
         const Vector *Vc_RESTRICT const end = &data[Factor];
         benchmark_loop(Benchmark("add", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
-                Vector tmp = ptr[0] + ptr[1];
-                Vc::forceToRegisters(tmp);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
+                    Vector tmp = ptr[0] + ptr[1];
+                    Vc::forceToRegisters(tmp);
+                }
             }
         }
         benchmark_loop(Benchmark("sub", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
-                Vector tmp = ptr[0] - ptr[1];
-                Vc::forceToRegisters(tmp);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
+                    Vector tmp = ptr[0] - ptr[1];
+                    Vc::forceToRegisters(tmp);
+                }
             }
         }
         benchmark_loop(Benchmark("mul", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
-                Vector tmp = ptr[0] * ptr[1];
-                Vc::forceToRegisters(tmp);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
+                    Vector tmp = ptr[0] * ptr[1];
+                    Vc::forceToRegisters(tmp);
+                }
             }
         }
         benchmark_loop(Benchmark("div", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
-                Vector tmp = ptr[0] / ptr[1];
-                Vc::forceToRegisters(tmp);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ++ptr) {
+                    Vector tmp = ptr[0] / ptr[1];
+                    Vc::forceToRegisters(tmp);
+                }
             }
         }
 
         Benchmark::setColumnData("unrolling", "2x unrolled");
         benchmark_loop(Benchmark("add", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
-                Vector tmp0 = ptr[0] + ptr[1];
-                Vector tmp1 = ptr[1] + ptr[2];
-                keepResults(tmp0, tmp1);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
+                    Vector tmp0 = ptr[0] + ptr[1];
+                    Vector tmp1 = ptr[1] + ptr[2];
+                    keepResults(tmp0, tmp1);
+                }
             }
         }
         benchmark_loop(Benchmark("sub", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
-                Vector tmp0 = ptr[0] - ptr[1];
-                Vector tmp1 = ptr[1] - ptr[2];
-                keepResults(tmp0, tmp1);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
+                    Vector tmp0 = ptr[0] - ptr[1];
+                    Vector tmp1 = ptr[1] - ptr[2];
+                    keepResults(tmp0, tmp1);
+                }
             }
         }
         benchmark_loop(Benchmark("mul", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
-                Vector tmp0 = ptr[0] * ptr[1];
-                Vector tmp1 = ptr[1] * ptr[2];
-                keepResults(tmp0, tmp1);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
+                    Vector tmp0 = ptr[0] * ptr[1];
+                    Vector tmp1 = ptr[1] * ptr[2];
+                    keepResults(tmp0, tmp1);
+                }
             }
         }
         benchmark_loop(Benchmark("div", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
-                Vector tmp0 = ptr[0] / ptr[1];
-                Vector tmp1 = ptr[1] / ptr[2];
-                keepResults(tmp0, tmp1);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 2) {
+                    Vector tmp0 = ptr[0] / ptr[1];
+                    Vector tmp1 = ptr[1] / ptr[2];
+                    keepResults(tmp0, tmp1);
+                }
             }
         }
 
         Benchmark::setColumnData("unrolling", "4x unrolled");
         benchmark_loop(Benchmark("add", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
-                Vector tmp0 = ptr[0] + ptr[1];
-                Vector tmp1 = ptr[1] + ptr[2];
-                Vector tmp2 = ptr[2] + ptr[3];
-                Vector tmp3 = ptr[3] + ptr[4];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
+                    Vector tmp0 = ptr[0] + ptr[1];
+                    Vector tmp1 = ptr[1] + ptr[2];
+                    Vector tmp2 = ptr[2] + ptr[3];
+                    Vector tmp3 = ptr[3] + ptr[4];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                }
             }
         }
         benchmark_loop(Benchmark("sub", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
-                Vector tmp0 = ptr[0] - ptr[1];
-                Vector tmp1 = ptr[1] - ptr[2];
-                Vector tmp2 = ptr[2] - ptr[3];
-                Vector tmp3 = ptr[3] - ptr[4];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
+                    Vector tmp0 = ptr[0] - ptr[1];
+                    Vector tmp1 = ptr[1] - ptr[2];
+                    Vector tmp2 = ptr[2] - ptr[3];
+                    Vector tmp3 = ptr[3] - ptr[4];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                }
             }
         }
         benchmark_loop(Benchmark("mul", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
-                Vector tmp0 = ptr[0] * ptr[1];
-                Vector tmp1 = ptr[1] * ptr[2];
-                Vector tmp2 = ptr[2] * ptr[3];
-                Vector tmp3 = ptr[3] * ptr[4];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
+                    Vector tmp0 = ptr[0] * ptr[1];
+                    Vector tmp1 = ptr[1] * ptr[2];
+                    Vector tmp2 = ptr[2] * ptr[3];
+                    Vector tmp3 = ptr[3] * ptr[4];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                }
             }
         }
         benchmark_loop(Benchmark("div", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
-                Vector tmp0 = ptr[0] / ptr[1];
-                Vector tmp1 = ptr[1] / ptr[2];
-                Vector tmp2 = ptr[2] / ptr[3];
-                Vector tmp3 = ptr[3] / ptr[4];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
+                    Vector tmp0 = ptr[0] / ptr[1];
+                    Vector tmp1 = ptr[1] / ptr[2];
+                    Vector tmp2 = ptr[2] / ptr[3];
+                    Vector tmp3 = ptr[3] / ptr[4];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                }
             }
         }
 
         Benchmark::setColumnData("unrolling", "8x unrolled");
         benchmark_loop(Benchmark("add", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
-                Vector tmp0 = ptr[0] + ptr[1];
-                Vector tmp1 = ptr[1] + ptr[2];
-                Vector tmp2 = ptr[2] + ptr[3];
-                Vector tmp3 = ptr[3] + ptr[4];
-                Vector tmp4 = ptr[4] + ptr[5];
-                Vector tmp5 = ptr[5] + ptr[6];
-                Vector tmp6 = ptr[6] + ptr[7];
-                Vector tmp7 = ptr[7] + ptr[8];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
-                keepResults(tmp4, tmp5, tmp6, tmp7);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
+                    Vector tmp0 = ptr[0] + ptr[1];
+                    Vector tmp1 = ptr[1] + ptr[2];
+                    Vector tmp2 = ptr[2] + ptr[3];
+                    Vector tmp3 = ptr[3] + ptr[4];
+                    Vector tmp4 = ptr[4] + ptr[5];
+                    Vector tmp5 = ptr[5] + ptr[6];
+                    Vector tmp6 = ptr[6] + ptr[7];
+                    Vector tmp7 = ptr[7] + ptr[8];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                    keepResults(tmp4, tmp5, tmp6, tmp7);
+                }
             }
         }
         benchmark_loop(Benchmark("sub", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
-                Vector tmp0 = ptr[0] - ptr[1];
-                Vector tmp1 = ptr[1] - ptr[2];
-                Vector tmp2 = ptr[2] - ptr[3];
-                Vector tmp3 = ptr[3] - ptr[4];
-                Vector tmp4 = ptr[4] - ptr[5];
-                Vector tmp5 = ptr[5] - ptr[6];
-                Vector tmp6 = ptr[6] - ptr[7];
-                Vector tmp7 = ptr[7] - ptr[8];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
-                keepResults(tmp4, tmp5, tmp6, tmp7);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
+                    Vector tmp0 = ptr[0] - ptr[1];
+                    Vector tmp1 = ptr[1] - ptr[2];
+                    Vector tmp2 = ptr[2] - ptr[3];
+                    Vector tmp3 = ptr[3] - ptr[4];
+                    Vector tmp4 = ptr[4] - ptr[5];
+                    Vector tmp5 = ptr[5] - ptr[6];
+                    Vector tmp6 = ptr[6] - ptr[7];
+                    Vector tmp7 = ptr[7] - ptr[8];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                    keepResults(tmp4, tmp5, tmp6, tmp7);
+                }
             }
         }
         benchmark_loop(Benchmark("mul", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
-                Vector tmp0 = ptr[0] * ptr[1];
-                Vector tmp1 = ptr[1] * ptr[2];
-                Vector tmp2 = ptr[2] * ptr[3];
-                Vector tmp3 = ptr[3] * ptr[4];
-                Vector tmp4 = ptr[4] * ptr[5];
-                Vector tmp5 = ptr[5] * ptr[6];
-                Vector tmp6 = ptr[6] * ptr[7];
-                Vector tmp7 = ptr[7] * ptr[8];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
-                keepResults(tmp4, tmp5, tmp6, tmp7);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
+                    Vector tmp0 = ptr[0] * ptr[1];
+                    Vector tmp1 = ptr[1] * ptr[2];
+                    Vector tmp2 = ptr[2] * ptr[3];
+                    Vector tmp3 = ptr[3] * ptr[4];
+                    Vector tmp4 = ptr[4] * ptr[5];
+                    Vector tmp5 = ptr[5] * ptr[6];
+                    Vector tmp6 = ptr[6] * ptr[7];
+                    Vector tmp7 = ptr[7] * ptr[8];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                    keepResults(tmp4, tmp5, tmp6, tmp7);
+                }
             }
         }
         benchmark_loop(Benchmark("div", valuesPerSecondFactor, "Op")) {
-            for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
-                Vector tmp0 = ptr[0] / ptr[1];
-                Vector tmp1 = ptr[1] / ptr[2];
-                Vector tmp2 = ptr[2] / ptr[3];
-                Vector tmp3 = ptr[3] / ptr[4];
-                Vector tmp4 = ptr[4] / ptr[5];
-                Vector tmp5 = ptr[5] / ptr[6];
-                Vector tmp6 = ptr[6] / ptr[7];
-                Vector tmp7 = ptr[7] / ptr[8];
-                keepResults(tmp0, tmp1, tmp2, tmp3);
-                keepResults(tmp4, tmp5, tmp6, tmp7);
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 8) {
+                    Vector tmp0 = ptr[0] / ptr[1];
+                    Vector tmp1 = ptr[1] / ptr[2];
+                    Vector tmp2 = ptr[2] / ptr[3];
+                    Vector tmp3 = ptr[3] / ptr[4];
+                    Vector tmp4 = ptr[4] / ptr[5];
+                    Vector tmp5 = ptr[5] / ptr[6];
+                    Vector tmp6 = ptr[6] / ptr[7];
+                    Vector tmp7 = ptr[7] / ptr[8];
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                    keepResults(tmp4, tmp5, tmp6, tmp7);
+                }
+            }
+        }
+
+        // fused multiply-add: two operations per result and new vector
+        Benchmark::setColumnData("Byte/Op", bytesPerOp(sizeof(Scalar) / 2.));
+        Benchmark::setColumnData("unrolling", "4x unrolled");
+        benchmark_loop(Benchmark("fma", valuesPerSecondFactor * 2, "Op")) {
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
+                    Vector tmp0 = Vc::fma(ptr[0], ptr[1], ptr[2]);
+                    Vector tmp1 = Vc::fma(ptr[1], ptr[2], ptr[3]);
+                    Vector tmp2 = Vc::fma(ptr[2], ptr[3], ptr[4]);
+                    Vector tmp3 = Vc::fma(ptr[3], ptr[4], ptr[0]);
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                }
             }
         }
 
+        mixed<2>(data, end, valuesPerSecondFactor, Repetitions);
+        mixed<4>(data, end, valuesPerSecondFactor, Repetitions);
+        mixed<8>(data, end, valuesPerSecondFactor, Repetitions);
+        mixed<16>(data, end, valuesPerSecondFactor, Repetitions);
+        mixed<32>(data, end, valuesPerSecondFactor, Repetitions);
+
         delete[] data;
     }
+
+    /**
+     * Mixed add/mul kernel with an arithmetic intensity of \p OpsPerElement operations per
+     * element loaded from memory: four independent chains of mul + add (Horner scheme) per
+     * iteration. The signed integer types compute in their unsigned counterpart, because the
+     * polynomial overflows for random inputs and signed overflow is undefined behavior. The
+     * conversion is a no-op for the same element width.
+     */
+    template <int OpsPerElement>
+    static void mixed(const Vector *data, const Vector *end, double valuesPerSecondFactor, int Repetitions)
+    {
+        std::ostringstream name;
+        name << "mixed add/mul (" << OpsPerElement << " Op/Element)";
+        Benchmark::setColumnData("Byte/Op", bytesPerOp(double(sizeof(Scalar)) / OpsPerElement));
+        Benchmark::setColumnData("unrolling", "4x unrolled");
+        typedef typename Unsigned<Vector>::type U;
+        const U c(3);
+        benchmark_loop(Benchmark(name.str(), valuesPerSecondFactor * OpsPerElement, "Op")) {
+            for (int rep = 0; rep < Repetitions; ++rep) {
+                for (const Vector *Vc_RESTRICT ptr = &data[0]; ptr < end; ptr += 4) {
+                    const U x0 = Vc::simd_cast<U>(ptr[0]);
+                    const U x1 = Vc::simd_cast<U>(ptr[1]);
+                    const U x2 = Vc::simd_cast<U>(ptr[2]);
+                    const U x3 = Vc::simd_cast<U>(ptr[3]);
+                    U tmp0 = x0;
+                    U tmp1 = x1;
+                    U tmp2 = x2;
+                    U tmp3 = x3;
+                    for (int k = 0; k < OpsPerElement / 2; ++k) {
+                        tmp0 = tmp0 * x0 + c;
+                        tmp1 = tmp1 * x1 + c;
+                        tmp2 = tmp2 * x2 + c;
+                        tmp3 = tmp3 * x3 + c;
+                    }
+                    keepResults(tmp0, tmp1, tmp2, tmp3);
+                }
+            }
+        }
+    }
 };
 
 int bmain()
 {
     Benchmark::addColumn("datatype");
     Benchmark::addColumn("unrolling");
+    Benchmark::addColumn("MemorySize");
+    Benchmark::addColumn("Byte/Op");
 
     Benchmark::setColumnData("datatype", "float_v");
     Arithmetics<float_v>::run();
@@ -28,11 +28,32 @@
 #define VC_32BIT
 #endif
 
+#ifndef NOINLINE
+#define NOINLINE
+#endif
+
+/*
+ * This file is compiled twice: as flops_autovect with the default optimization flags and as
+ * flops_noautovect with auto-vectorization disabled (VC_BENCHMARK_NO_AUTOVEC is defined then).
+ * Every kernel exists as plain C++ loop and as the equivalent Vc implementation. The Vc kernels
+ * only run in flops_autovect, so that the two data files together list every kernel as
+ * "scalar", "auto-vectorized" and "Vc" (cf. the Implementation column).
+ */
+#ifdef VC_BENCHMARK_NO_AUTOVEC
+static const char *const PlainImplementation = "scalar";
+#else
+static const char *const PlainImplementation = "auto-vectorized";
+#endif
+
 enum {
     VectorSize = 4,
 #define VectorAlignment 32
     Factor = 2000000 / VectorSize,
-    Size = 8 * VectorSize
+    Size = 8 * VectorSize,
+    // the array kernels work on L1 resident data, so that they measure the code generation and
+    // not the memory subsystem
+    ArraySize = 2048,
+    Repetitions = 64
 };
 
 static float randomF(float min, float max)
@@ -43,10 +64,276 @@ static float randomF(float min, float max)
 
 static float randomF12() { return randomF(1.f, 2.f); }
 
+/// Forces the compiler to assume that the arrays changed, so that it cannot hoist a kernel call
+/// out of the repetitions loop.
+static inline void clobberMemory()
+{
+#ifdef __GNUC__
+    asm volatile("" ::: "memory");
+#endif
+}
+
 int blackHole = true;
 
+struct Point
+{
+    float x, y, z;
+};
+
+namespace Plain/*{{{*/
+{
+// without -ffast-math the compiler may not reorder the additions and thus cannot vectorize
+NOINLINE float dot(const float *a, const float *b, int n)
+{
+    float sum = 0.f;
+    for (int i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NOINLINE void saxpy(float alpha, const float *x, float *y, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        y[i] = alpha * x[i] + y[i];
+    }
+}
+
+NOINLINE void stencil(const float *in, float *out, int n)
+{
+    for (int i = 1; i < n - 1; ++i) {
+        out[i] = .25f * in[i - 1] + .5f * in[i] + .25f * in[i + 1];
+    }
+}
+
+// the early exit makes the trip count unknown on loop entry
+NOINLINE int findFirstGreater(const float *a, float threshold, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        if (a[i] > threshold) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// a conditional store: vectorizing it requires masked stores
+NOINLINE void conditionalUpdate(const float *a, const float *b, float *out, float threshold, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        if (a[i] > threshold) {
+            out[i] = a[i] * b[i];
+        }
+    }
+}
+
+NOINLINE void gather(const float *table, const int *indexes, const float *x, float *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        out[i] = table[indexes[i]] * x[i];
+    }
+}
+
+NOINLINE void interleaved(const Point *p, float *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        out[i] = p[i].x * p[i].x + p[i].y * p[i].y + p[i].z * p[i].z;
+    }
+}
+}  // namespace Plain/*}}}*/
+
+#ifndef VC_BENCHMARK_NO_AUTOVEC
+namespace WithVc/*{{{*/
+{
+using Vc::float_v;
+using Vc::float_m;
+
+NOINLINE float dot(const float *a, const float *b, int n)
+{
+    float_v sum = float_v::Zero();
+    for (int i = 0; i < n; i += float_v::Size) {
+        sum += float_v(&a[i]) * float_v(&b[i]);
+    }
+    return sum.sum();
+}
+
+NOINLINE void saxpy(float alpha, const float *x, float *y, int n)
+{
+    for (int i = 0; i < n; i += float_v::Size) {
+        (alpha * float_v(&x[i]) + float_v(&y[i])).store(&y[i]);
+    }
+}
+
+NOINLINE void stencil(const float *in, float *out, int n)
+{
+    int i = 1;
+    for (; i + int(float_v::Size) < n; i += float_v::Size) {
+        const float_v left(&in[i - 1], Vc::Unaligned);
+        const float_v center(&in[i], Vc::Unaligned);
+        const float_v right(&in[i + 1], Vc::Unaligned);
+        (.25f * left + .5f * center + .25f * right).store(&out[i], Vc::Unaligned);
+    }
+    for (; i < n - 1; ++i) {
+        out[i] = .25f * in[i - 1] + .5f * in[i] + .25f * in[i + 1];
+    }
+}
+
+NOINLINE int findFirstGreater(const float *a, float threshold, int n)
+{
+    for (int i = 0; i < n; i += float_v::Size) {
+        const float_m found = float_v(&a[i]) > threshold;
+        if (any_of(found)) {
+            return i + found.firstOne();
+        }
+    }
+    return n;
+}
+
+NOINLINE void conditionalUpdate(const float *a, const float *b, float *out, float threshold, int n)
+{
+    for (int i = 0; i < n; i += float_v::Size) {
+        const float_v x(&a[i]);
+        float_v r(&out[i]);
+        r(x > threshold) = x * float_v(&b[i]);
+        r.store(&out[i]);
+    }
+}
+
+NOINLINE void gather(const float *table, const int *indexes, const float *x, float *out, int n)
+{
+    for (int i = 0; i < n; i += float_v::Size) {
+        const float_v::IndexType idx(&indexes[i]);
+        (float_v(table, idx) * float_v(&x[i])).store(&out[i]);
+    }
+}
+
+NOINLINE void interleaved(const Point *p, float *out, int n)
+{
+    Vc::InterleavedMemoryWrapper<const Point, float_v> wrapper(p);
+    for (int i = 0; i < n; i += float_v::Size) {
+        float_v x, y, z;
+        (x, y, z) = wrapper[i];
+        (x * x + y * y + z * z).store(&out[i]);
+    }
+}
+}  // namespace WithVc/*}}}*/
+#else
+// the Vc rows are disabled, but the kernel lambdas still refer to WithVc
+namespace WithVc = Plain;
+#endif
+
+class Suite/*{{{*/
+{
+public:
+    Suite()
+        : a(Vc::malloc<float, Vc::AlignOnVector>(ArraySize)),
+          b(Vc::malloc<float, Vc::AlignOnVector>(ArraySize)),
+          out(Vc::malloc<float, Vc::AlignOnVector>(ArraySize)),
+          table(Vc::malloc<float, Vc::AlignOnVector>(ArraySize)),
+          indexes(Vc::malloc<int, Vc::AlignOnVector>(ArraySize)),
+          points(new Point[ArraySize])
+    {
+        for (int i = 0; i < ArraySize; ++i) {
+            a[i] = randomF(0.f, 1.f);
+            b[i] = randomF12();
+            out[i] = 0.f;
+            table[i] = randomF12();
+            indexes[i] = rand() % ArraySize;
+            points[i].x = randomF12();
+            points[i].y = randomF12();
+            points[i].z = randomF12();
+        }
+    }
+    ~Suite()
+    {
+        Vc::free(a);
+        Vc::free(b);
+        Vc::free(out);
+        Vc::free(table);
+        Vc::free(indexes);
+        delete[] points;
+    }
+
+    void run()
+    {
+        float sum = 0.f;
+        runPlainAndVc("dot product", 2, [&](bool vc) {
+            sum += vc ? WithVc::dot(a, b, ArraySize) : Plain::dot(a, b, ArraySize);
+        });
+        runPlainAndVc("saxpy", 2, [&](bool vc) {
+            vc ? WithVc::saxpy(1e-6f, a, out, ArraySize) : Plain::saxpy(1e-6f, a, out, ArraySize);
+        });
+        runPlainAndVc("stencil", 5, [&](bool vc) {
+            vc ? WithVc::stencil(a, out, ArraySize) : Plain::stencil(a, out, ArraySize);
+        });
+
+        // the search ends after 3/4 of the array
+        const int hit = ArraySize * 3 / 4;
+        const float aHit = a[hit];
+        a[hit] = 2.f;
+        int found = 0;
+        runPlainAndVc("early exit search", 1, [&](bool vc) {
+            found += vc ? WithVc::findFirstGreater(a, 1.5f, ArraySize)
+                        : Plain::findFirstGreater(a, 1.5f, ArraySize);
+        }, hit + 1);
+        a[hit] = aHit;
+
+        runPlainAndVc("conditional update", 1, [&](bool vc) {
+            vc ? WithVc::conditionalUpdate(a, b, out, .5f, ArraySize)
+               : Plain::conditionalUpdate(a, b, out, .5f, ArraySize);
+        });
+        runPlainAndVc("gather", 1, [&](bool vc) {
+            vc ? WithVc::gather(table, indexes, b, out, ArraySize)
+               : Plain::gather(table, indexes, b, out, ArraySize);
+        });
+        runPlainAndVc("interleaved structs", 5, [&](bool vc) {
+            vc ? WithVc::interleaved(points, out, ArraySize) : Plain::interleaved(points, out, ArraySize);
+        });
+
+        blackHole &= (sum > 0.f) & (found > 0) & (out[ArraySize / 2] > 0.f);
+    }
+
+private:
+    /**
+     * Benchmarks \p kernel(false), the plain loop, and \p kernel(true), the Vc implementation,
+     * under the same name. \p flops is the number of FLOPs per element, \p elements the number of
+     * elements one call of the kernel processes.
+     */
+    template <typename F>
+    static void runPlainAndVc(const char *name, int flops, F &&kernel, int elements = ArraySize)
+    {
+        const double factor = double(flops) * elements * Repetitions;
+        Benchmark::setColumnData("Implementation", PlainImplementation);
+        benchmark_loop(Benchmark(name, factor, "FLOP")) {
+            for (int r = 0; r < Repetitions; ++r) {
+                kernel(false);
+                clobberMemory();
+            }
+        }
+#ifndef VC_BENCHMARK_NO_AUTOVEC
+        Benchmark::setColumnData("Implementation", "Vc");
+        benchmark_loop(Benchmark(name, factor, "FLOP")) {
+            for (int r = 0; r < Repetitions; ++r) {
+                kernel(true);
+                clobberMemory();
+            }
+        }
+#endif
+    }
+
+    float *const a;
+    float *const b;
+    float *const out;
+    float *const table;
+    int *const indexes;
+    Point *const points;
+};/*}}}*/
+
 int bmain()
 {
+    Benchmark::addColumn("Implementation");
+    Benchmark::setColumnData("Implementation", PlainImplementation);
+
     Benchmark timer("auto-vect reference", 2 * Size * Factor, "FLOP");
     while (timer.wantsMoreDataPoints()) {
 #ifdef __GNUC__
@@ -76,5 +363,8 @@ int bmain()
         }
     }
     timer.Print();
+
+    Suite suite;
+    suite.run();
     return 0;
 }
@@ -90,6 +90,18 @@ echo
 fifo="$resultsDir/.fifo"
 mkfifo "$fifo"
 
+outfileFor()
+{
+  outfile=$resultsDir/${1}_${2}
+  if test "$2" = "avx"; then
+    $haveXop && outfile=${outfile}-mxop
+    $haveFma4 && outfile=${outfile}-mfma4
+  else
+    $haveAvx && outfile=${outfile}-mavx
+  fi
+  outfile=${outfile}-run$3.dat
+}
+
 executeBench()
 {
   name=${1}_${2}
@@ -100,14 +112,7 @@ executeBench()
     coreid=${idleCores[${#idleCores[@]}-1]}
     unset idleCores[${#idleCores[@]}-1]
     (
-    outfile=$resultsDir/$name
-    if test "$2" = "avx"; then
-      $haveXop && outfile=${outfile}-mxop
-      $haveFma4 && outfile=${outfile}-mfma4
-    else
-      $haveAvx && outfile=${outfile}-mavx
-    fi
-    outfile=${outfile}-run$3.dat
+    outfileFor $1 $2 $3
     printf "%22s -o %s\tStarted.\n" "$name" "$outfile"
     if numactl --physcpubind=$coreid --localalloc ./$name -o $outfile >/dev/null 2>&1; then
       printf "%22s -o %s\tDone.\n" "$name" "$outfile"
@@ -122,6 +127,25 @@ executeBench()
   fi
 }
 
+# The multi-threaded benchmarks scale over 1..N of the CPUs they may run on. They run one at a time
+# on all usable cores, after the single-core benchmarks are done.
+executeExclusive()
+{
+  name=${1}_${2}
+  if test -x ./$name; then
+    outfileFor $1 $2 $3
+    printf "%22s -o %s\tStarted.\n" "$name" "$outfile"
+    if numactl --physcpubind=`IFS=,; echo "${usableCores[*]}"` --localalloc ./$name -o $outfile >/dev/null 2>&1; then
+      printf "%22s -o %s\tDone.\n" "$name" "$outfile"
+    else
+      printf "%22s -o %s\tFAILED.\n" "$name" "$outfile"
+      rm -f $outfile
+    fi
+  else
+    printf "%22s SKIPPED\n" "$name"
+  fi
+}
+
 if which benchmarking.sh >/dev/null; then
   echo "Calling 'benchmarking.sh start' to disable powermanagement and Turbo-Mode"
   benchmarking.sh start
@@ -129,7 +153,7 @@ fi
 
 for run in 1 2 3; do
 for bench in \
-  interleavedmemorywrapper flops arithmetics2 gather scatter mask compare math memio dhryrock whetrock mandelbrotbench
+  interleavedmemorywrapper arithmetics2 gather scatter mask compare math memio
 do
   executeBench $bench scalar $run
   $haveSse && executeBench $bench sse $run
@@ -141,6 +165,15 @@ wait
 cat "$fifo" >/dev/null
 rm -f "$fifo"
 
+for run in 1 2 3; do
+for bench in flops dhryrock whetrock mandelbrot; do
+  executeExclusive $bench scalar $run
+  $haveSse && executeExclusive $bench sse $run
+  $haveAvx && executeExclusive $bench avx $run
+  $haveAvx2 && executeExclusive $bench avx2 $run
+done
+done
+
 echo "Packing results into ${resultsDir}.tar.gz"
 tar -czf ${resultsDir}.tar.gz ${resultsDir}/
 
@@ -20,8 +20,14 @@
 #include "benchmark.h"
 #include <Vc/Vc>
 #include <Vc/support.h>
+#include <Vc/cpuid.h>
+#include <chrono>
 #include <map>
 #include <set>
+#if !defined _WIN32 && !defined _WIN64
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
 
 // limit to max. 10s per single benchmark
 static double g_Time = 10.;
@@ -30,6 +36,36 @@ static int g_skip = 0;
 static std::set<std::string> g_skipReasons;
 static std::map<std::string, std::set<std::string> > g_skipLists;
 
+// --budget: a quiet pilot pass over all cases, then a final pass that gets the remaining time
+// distributed by confidence interval width (cf. runWithBudget)
+enum SchedulerPass {
+    UnscheduledPass,
+    PilotPass,
+    FinalPass
+};
+static double g_budget = 0.;
+static SchedulerPass g_pass = UnscheduledPass;
+static double g_deadline = 0.;
+
+static double steadySeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct CaseStatistics
+{
+    double sum;        // real time of the pilot pass
+    double squares;    // squared real time of the pilot pass
+    int dataPoints;
+    double wall;       // seconds from construction to Print, including the untimed parts
+    double width;      // relative half-width of the 95% confidence interval of the real time
+    double allotment;  // wall seconds in the final pass
+};
+// the key is the benchmark name and its occurrence within the pass; the extra columns cannot be
+// part of it because some of them hold measured values
+static std::map<std::string, CaseStatistics> g_cases;
+static std::map<std::string, int> g_caseOccurrences;
+
 const char *printHelp2 =
 "  -t <seconds>        maximum time to run a single benchmark (10s)\n"
 "  -cpu (all|any|<id>) CPU to pin the benchmark to\n"
@@ -82,6 +118,149 @@ const char Benchmark::cyanEsc   [8] = "\033[1;36m";
 const char Benchmark::reverseEsc[5] = "\033[7m";
 const char Benchmark::normalEsc [5] = "\033[0m";
 
+/// the Vc implementation the benchmark is compiled for, with the extensions it enables
+static std::string implementationName()
+{
+    std::string name =
+#if Vc_IMPL_AVX2 || VC_IMPL_AVX2
+        "AVX2";
+#elif Vc_IMPL_AVX || VC_IMPL_AVX
+        "AVX";
+#elif Vc_IMPL_SSE4_1 || VC_IMPL_SSE4_1
+#if defined Vc_DISABLE_PTEST || defined VC_DISABLE_PTEST
+        "SSE4.1 w/o PTEST";
+#else
+        "SSE4.1";
+#endif
+#elif Vc_IMPL_SSSE3 || VC_IMPL_SSSE3
+        "SSSE3";
+#elif Vc_IMPL_SSE3 || VC_IMPL_SSE3
+        "SSE3";
+#elif Vc_IMPL_SSE2 || VC_IMPL_SSE2
+        "SSE2";
+#elif Vc_IMPL_Scalar || VC_IMPL_Scalar
+        "Scalar";
+#else
+        "non-Vc";
+#endif
+#if Vc_IMPL_FMA || VC_IMPL_FMA
+    name += "+FMA";
+#endif
+#if Vc_IMPL_FMA4 || VC_IMPL_FMA4
+    name += "+FMA4";
+#endif
+#if Vc_IMPL_XOP || VC_IMPL_XOP
+    name += "+XOP";
+#endif
+#if Vc_IMPL_BMI2 || VC_IMPL_BMI2
+    name += "+BMI2";
+#endif
+    return name;
+}
+
+/// the first line of \p path or an empty string if it cannot be read
+static std::string readFirstLine(const char *path)
+{
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+static void writeMetadata(std::ostream &out, const std::string &key, const std::string &value)
+{
+    out << "# " << key << "\t: " << (value.empty() ? "unknown" : value) << '\n';
+}
+
+static std::string onOff(const std::string &value, const char *on)
+{
+    return value.empty() ? value : value == on ? "on" : "off";
+}
+
+/**
+ * Writes the machine and build the results were measured with as "# key\t: value" lines, the
+ * same layout as the metadata file of benchmark-all.sh. Values that cannot be determined on this
+ * system are written as "unknown".
+ */
+static void writeMetadata(std::ostream &out)
+{
+    writeMetadata(out, "Vc_IMPL", implementationName());
+#ifdef Vc_VERSION_STRING
+    writeMetadata(out, "Vc version", Vc_VERSION_STRING);
+#elif defined VC_VERSION_STRING
+    writeMetadata(out, "Vc version", VC_VERSION_STRING);
+#endif
+#if defined __VERSION__
+    writeMetadata(out, "compiler", __VERSION__);
+#elif defined _MSC_FULL_VER
+    std::ostringstream msc;
+    msc << "MSVC " << _MSC_FULL_VER;
+    writeMetadata(out, "compiler", msc.str());
+#endif
+#ifdef VC_BENCHMARK_BUILD_TYPE
+    writeMetadata(out, "build type", VC_BENCHMARK_BUILD_TYPE);
+#endif
+#if defined VC_BENCHMARK_CXX_FLAGS && defined VC_BENCHMARK_TARGET_FLAGS
+    writeMetadata(out, "flags", VC_BENCHMARK_CXX_FLAGS " " VC_BENCHMARK_TARGET_FLAGS);
+#elif defined VC_BENCHMARK_CXX_FLAGS
+    writeMetadata(out, "flags", VC_BENCHMARK_CXX_FLAGS);
+#endif
+
+    // the CPUID signature as decoded by the kernel, from the first processor entry
+    {
+        static const char *const keys[] = {
+            "vendor_id", "cpu family", "model", "model name", "stepping", "microcode"
+        };
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line) && !line.empty()) {
+            const std::string::size_type colon = line.find(':');
+            if (colon == std::string::npos || colon == 0) {
+                continue;
+            }
+            const std::string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+            if (std::find(keys, keys + sizeof(keys) / sizeof(keys[0]), key) !=
+                    keys + sizeof(keys) / sizeof(keys[0])) {
+                writeMetadata(out, key, colon + 2 < line.size() ? line.substr(colon + 2) : "");
+            }
+        }
+    }
+    std::ostringstream cache;
+    cache << Vc::CpuId::L1Data() / 1024 << " KiB";
+    writeMetadata(out, "L1d cache", cache.str());
+    cache.str(std::string());
+    cache << Vc::CpuId::L2Data() / 1024 << " KiB";
+    writeMetadata(out, "L2 cache", cache.str());
+    cache.str(std::string());
+    if (Vc::CpuId::L3Data() > 0) {
+        cache << Vc::CpuId::L3Data() / 1024 << " KiB";
+    }
+    writeMetadata(out, "L3 cache", cache.str());
+    cache.str(std::string());
+    cache << int(Vc::CpuId::cacheLineSize()) << " Byte";
+    writeMetadata(out, "cache line", cache.str());
+
+    writeMetadata(out, "governor",
+            readFirstLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"));
+    std::string turbo = onOff(readFirstLine("/sys/devices/system/cpu/intel_pstate/no_turbo"), "0");
+    if (turbo.empty()) {
+        turbo = onOff(readFirstLine("/sys/devices/system/cpu/cpufreq/boost"), "1");
+    }
+    writeMetadata(out, "turbo", turbo);
+    writeMetadata(out, "SMT", onOff(readFirstLine("/sys/devices/system/cpu/smt/active"), "1"));
+#if !defined _WIN32 && !defined _WIN64
+    utsname uts;
+    if (uname(&uts) == 0) {
+        writeMetadata(out, "kernel", std::string(uts.sysname) + ' ' + uts.release + ' ' + uts.version);
+        writeMetadata(out, "machine", uts.machine);
+    }
+    char hostname[256] = {};
+    if (gethostname(hostname, sizeof(hostname) - 1) == 0) {
+        writeMetadata(out, "hostname", hostname);
+    }
+#endif
+}
+
 Benchmark::FileWriter::FileWriter(const std::string &filename)
     : m_finalized(false)
 {
@@ -109,7 +288,8 @@ void Benchmark::FileWriter::declareData(const std::string &name, const std::list
     m_currentName = '"' + name + '"';
     if (m_header != header) {
         if (m_header.empty()) {
-            m_file << "Version 4\n";
+            m_file << "Version 5\n";
+            writeMetadata(m_file);
         }
         m_header = header;
         m_file << "\"benchmark.name\"\t\"benchmark.arch\"";
@@ -127,26 +307,7 @@ void Benchmark::FileWriter::declareData(const std::string &name, const std::list
 
 void Benchmark::FileWriter::addDataLine(const std::list<std::string> &data)
 {
-    m_file << m_currentName << '\t' <<
-#if VC_IMPL_AVX
-            "\"AVX\"";
-#elif VC_IMPL_SSE4_1
-#ifdef VC_DISABLE_PTEST
-            "\"SSE4.1 w/o PTEST\"";
-#else
-            "\"SSE4.1\"";
-#endif
-#elif VC_IMPL_SSSE3
-            "\"SSSE3\"";
-#elif VC_IMPL_SSE3
-            "\"SSE3\"";
-#elif VC_IMPL_SSE2
-            "\"SSE2\"";
-#elif VC_IMPL_Scalar
-            "\"Scalar\"";
-#else
-            "\"non-Vc\"";
-#endif
+    m_file << m_currentName << "\t\"" << implementationName() << '"';
     for (std::list<ExtraColumn>::const_iterator i = m_extraColumns.begin();
             i != m_extraColumns.end(); ++i) {
         m_file << '\t' << i->data;
@@ -183,9 +344,11 @@ void Benchmark::FileWriter::setColumnData(const std::string &name, const std::st
 }
 
 Benchmark::FileWriter *Benchmark::s_fileWriter = 0;
+double Benchmark::s_lastCyclesPerUnit = 0.;
 
 Benchmark::Benchmark(const std::string &_name, double factor, const std::string &X)
-    : fName(_name), fFactor(factor), fX(X), m_dataPointsCount(0), m_skip(g_skip)
+    : fName(_name), fFactor(factor), fX(X), m_dataPointsCount(0), m_allotment(0.),
+    m_caseStart(0.), m_skip(g_skip)
 {
     if (m_skip) {
         return;
@@ -198,6 +361,19 @@ Benchmark::Benchmark(const std::string &_name, double factor, const std::string
     for (int i = 0; i < 3; ++i) {
         m_mean[i] = m_stddev[i] = 0.;
     }
+    if (g_pass != UnscheduledPass) {
+        std::ostringstream key;
+        key << fName << '#' << g_caseOccurrences[fName]++;
+        m_case = key.str();
+        m_caseStart = steadySeconds();
+        if (g_pass == PilotPass) {
+            return;
+        }
+        std::map<std::string, CaseStatistics>::const_iterator it = g_cases.find(m_case);
+        if (it != g_cases.end()) {
+            m_allotment = it->second.allotment;
+        }
+    }
     enum {
         WCHARSIZE = sizeof("━") - 1
     };
@@ -239,6 +415,13 @@ bool Benchmark::wantsMoreDataPoints() const
         return false;
     } else if (m_dataPointsCount < 3) { // hard limit on the number of data points; otherwise talking about stddev is bogus
         return true;
+    } else if (g_pass == PilotPass) {
+        return false;
+    } else if (g_pass == FinalPass) {
+        // start another data point only if it is expected to end within allotment and budget
+        const double now = steadySeconds();
+        const double next = (now - m_caseStart) / m_dataPointsCount;
+        return now + next <= m_caseStart + m_allotment && now + next < g_deadline;
     } else if (m_mean[0] > g_Time) { // limit on the time
         return false;
     } else if (m_dataPointsCount < 30) { // we want initial statistics
@@ -400,13 +583,24 @@ inline void Benchmark::printBottomLine() const
 bool Benchmark::Print()
 {
     if (m_skip) {
+        s_lastCyclesPerUnit = 0.;
+        return false;
+    }
+    const bool interpret = (fFactor != 0.);
+    if (g_pass == PilotPass) {
+        CaseStatistics &stats = g_cases[m_case];
+        stats.sum = m_mean[0];
+        stats.squares = m_stddev[0];
+        stats.dataPoints = m_dataPointsCount;
+        stats.wall = steadySeconds() - m_caseStart;
+        const double cycles = m_dataPointsCount > 0 ? m_mean[1] / m_dataPointsCount : 0.;
+        s_lastCyclesPerUnit = interpret ? cycles / fFactor : cycles;
         return false;
     }
     std::streambuf *backup = std::cout.rdbuf();
     if (s_fileWriter) {
         std::cout.rdbuf(0);
     }
-    const bool interpret = (fFactor != 0.);
 
     std::list<std::string> header;
     header
@@ -473,6 +667,7 @@ bool Benchmark::Print()
     dataLine << fFactor / m_mean[2] << stddevint[2];
 #endif
     dataLine << fFactor;
+    s_lastCyclesPerUnit = interpret ? m_mean[1] / fFactor : m_mean[1];
 
     std::cout << "\n┃ ";
 #ifdef VC_USE_CPU_TIME
@@ -533,6 +728,9 @@ void printHelp(const char *name) {
         << "  -h, --help          print this message\n"
         << "  -o <filename>       output measurements to a file instead of stdout\n"
         << "  --skip <name> <value>  skip tests with the name/column set to the given value\n"
+        << "  --budget <seconds>  finish within the given time: after a short pilot pass over\n"
+        << "                      all tests, the remaining time goes to the tests with the\n"
+        << "                      widest confidence intervals (-t still limits each test)\n"
         ;
     if (printHelp2) {
         std::cout << printHelp2;
@@ -547,6 +745,162 @@ ArgumentVector g_arguments;
 
 #include "cpuset.h"
 
+enum {
+    UseAllCpus = -2,
+    UseAnyOneCpu = -1
+};
+
+/// calls bmain once, or once per CPU for -cpu all
+static int runBenchmarks(int useCpus)
+{
+    int r = 0;
+    if (useCpus == UseAnyOneCpu) {
+        r += bmain();
+        Benchmark::finalize();
+#if !defined _WIN32 && !defined _WIN64
+	} else {
+        cpu_set_t cpumask;
+        sched_getaffinity(0, sizeof(cpu_set_t), &cpumask);
+        int cpucount = cpuCount(&cpumask);
+        if (cpucount > 1) {
+            Benchmark::addColumn("CPU_ID");
+        }
+        if (useCpus == UseAllCpus) {
+            for (int cpuid = 0; cpuid < cpucount; ++cpuid) {
+                if (cpucount > 1) {
+                    std::ostringstream str;
+                    str << cpuid;
+                    Benchmark::setColumnData("CPU_ID", str.str());
+                }
+                cpuZero(&cpumask);
+                cpuSet(cpuid, &cpumask);
+                sched_setaffinity(0, sizeof(cpu_set_t), &cpumask);
+                r += bmain();
+                Benchmark::finalize();
+            }
+        } else {
+            int cpuid = std::min(cpucount - 1, std::max(0, useCpus));
+            if (cpucount > 1) {
+                std::ostringstream str;
+                str << cpuid;
+                Benchmark::setColumnData("CPU_ID", str.str());
+            }
+            cpuZero(&cpumask);
+            cpuSet(cpuid, &cpumask);
+            sched_setaffinity(0, sizeof(cpu_set_t), &cpumask);
+            r += bmain();
+            Benchmark::finalize();
+        }
+#endif
+    }
+    return r;
+}
+
+/**
+ * The wall time \p stats needs in the final pass to reach the relative width \p target. A data
+ * point costs the wall time per data point of the pilot pass, which includes the work the case
+ * does outside the timed region.
+ */
+static double allotmentFor(const CaseStatistics &stats, double target)
+{
+    const double n = stats.dataPoints;
+    double dataPoints = 3.; // the minimum of every case
+    if (stats.width > target) {
+        const double ratio = stats.width / target;
+        dataPoints = std::max(dataPoints, n * ratio * ratio);
+    }
+    // -t limits the measured time of the case
+    dataPoints = std::min(dataPoints, std::max(3., g_Time * n / stats.sum));
+    return dataPoints * stats.wall / n;
+}
+
+/**
+ * Distributes \p seconds of wall time over the cases of the pilot pass. The confidence
+ * interval shrinks with the square root of the number of data points, so the target width is
+ * bisected until the time the cases above it need to reach it fits: the widest intervals get
+ * time first and no case gets more than -t allows.
+ */
+static void distributeBudget(double seconds)
+{
+    typedef std::map<std::string, CaseStatistics>::iterator Iterator;
+    double widest = 0.;
+    for (Iterator it = g_cases.begin(); it != g_cases.end(); ++it) {
+        CaseStatistics &stats = it->second;
+        stats.width = 0.;
+        if (stats.dataPoints > 0 && stats.sum > 0.) {
+            const double n = stats.dataPoints;
+            const double mean = stats.sum / n;
+            const double variance = std::max(0., stats.squares / n - mean * mean);
+            stats.width = 1.96 * std::sqrt(variance / n) / mean;
+            widest = std::max(widest, stats.width);
+        }
+    }
+    double low = 0.;
+    double high = widest;
+    for (int i = 0; i < 50; ++i) {
+        const double target = 0.5 * (low + high);
+        double needed = 0.;
+        for (Iterator it = g_cases.begin(); it != g_cases.end(); ++it) {
+            if (it->second.dataPoints > 0 && it->second.sum > 0.) {
+                needed += allotmentFor(it->second, target);
+            }
+        }
+        if (needed > seconds) {
+            low = target;
+        } else {
+            high = target;
+        }
+    }
+    for (Iterator it = g_cases.begin(); it != g_cases.end(); ++it) {
+        it->second.allotment =
+            it->second.dataPoints > 0 && it->second.sum > 0. ? allotmentFor(it->second, high) : 0.;
+    }
+}
+
+/**
+ * --budget: a quiet pilot pass of three data points per case estimates the cost per data point,
+ * the confidence intervals and the time spent outside the cases. The final pass repeats
+ * every case with its share of the remaining budget and prints the statistics of its own data
+ * points only, so that a case that does not match its pilot (e.g. because bmain branches on
+ * measured results) is merely scheduled badly. 10% of the remaining budget is held back for
+ * misestimates, and no case starts a data point that would end after the deadline.
+ */
+static int runWithBudget(int useCpus)
+{
+    const double start = steadySeconds();
+    g_deadline = start + g_budget;
+
+    // the pilot pass is quiet, including what bmain itself prints
+    std::streambuf *backup = std::cout.rdbuf(0);
+    g_pass = PilotPass;
+    runBenchmarks(useCpus);
+    std::cout.rdbuf(backup);
+    const double pilot = steadySeconds() - start;
+    double inCases = 0.;
+    double minimum = 0.;
+    for (std::map<std::string, CaseStatistics>::const_iterator it = g_cases.begin();
+            it != g_cases.end(); ++it) {
+        if (it->second.dataPoints > 0) {
+            inCases += it->second.wall;
+            minimum += it->second.wall * 3. / it->second.dataPoints;
+        }
+    }
+    const double overhead = std::max(0., pilot - inCases);
+    const double available = 0.9 * (g_budget - pilot - overhead);
+    if (available < minimum) {
+        std::cerr << "--budget " << g_budget << ": the pilot pass took " << pilot
+                  << " s, the results will take about " << pilot + overhead + minimum - g_budget
+                  << " s longer\n";
+    }
+    distributeBudget(available);
+
+    g_caseOccurrences.clear();
+    g_pass = FinalPass;
+    const int r = runBenchmarks(useCpus);
+    g_pass = UnscheduledPass;
+    return r;
+}
+
 int main(int argc, char **argv)
 {
     if (!Vc::currentImplementationSupported()) {
@@ -572,10 +926,6 @@ int main(int argc, char **argv)
 
     int i = 2;
     Benchmark::FileWriter *file = 0;
-    enum {
-        UseAllCpus = -2,
-        UseAnyOneCpu = -1
-    };
     int useCpus = UseAnyOneCpu;
     while (argc > i) {
         if (std::strcmp(argv[i - 1], "-o") == 0) {
@@ -584,6 +934,9 @@ int main(int argc, char **argv)
         } else if (std::strcmp(argv[i - 1], "-t") == 0) {
             g_Time = atof(argv[i]);
             i += 2;
+        } else if (std::strcmp(argv[i - 1], "--budget") == 0) {
+            g_budget = atof(argv[i]);
+            i += 2;
         } else if (std::strcmp(argv[i - 1], "-cpu") == 0) {
 // On OS X there is no way to set CPU affinity
 // TODO there is a way to ask the system to not move the process around
@@ -623,44 +976,10 @@ int main(int argc, char **argv)
     }
 
     int r = 0;
-    if (useCpus == UseAnyOneCpu) {
-        r += bmain();
-        Benchmark::finalize();
-#if !defined _WIN32 && !defined _WIN64
-	} else {
-        cpu_set_t cpumask;
-        sched_getaffinity(0, sizeof(cpu_set_t), &cpumask);
-        int cpucount = cpuCount(&cpumask);
-        if (cpucount > 1) {
-            Benchmark::addColumn("CPU_ID");
-        }
-        if (useCpus == UseAllCpus) {
-            for (int cpuid = 0; cpuid < cpucount; ++cpuid) {
-                if (cpucount > 1) {
-                    std::ostringstream str;
-                    str << cpuid;
-                    Benchmark::setColumnData("CPU_ID", str.str());
-                }
-                cpuZero(&cpumask);
-                cpuSet(cpuid, &cpumask);
-                sched_setaffinity(0, sizeof(cpu_set_t), &cpumask);
-                r += bmain();
-                Benchmark::finalize();
-            }
-        } else {
-            int cpuid = std::min(cpucount - 1, std::max(0, useCpus));
-            if (cpucount > 1) {
-                std::ostringstream str;
-                str << cpuid;
-                Benchmark::setColumnData("CPU_ID", str.str());
-            }
-            cpuZero(&cpumask);
-            cpuSet(cpuid, &cpumask);
-            sched_setaffinity(0, sizeof(cpu_set_t), &cpumask);
-            r += bmain();
-            Benchmark::finalize();
-        }
-#endif
+    if (g_budget > 0.) {
+        r = runWithBudget(useCpus);
+    } else {
+        r = runBenchmarks(useCpus);
     }
     delete file;
     return r;
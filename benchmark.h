@@ -90,6 +90,9 @@ public:
     static void addColumn(const std::string &name);
     static void setColumnData(const std::string &name, const std::string &data);
     static void finalize();
+    /// Cycles per unit (Cycles/X column) of the benchmark printed last, for benchmarks that
+    /// compare their own results (e.g. to find crossover points).
+    static double lastCyclesPerUnit() { return s_lastCyclesPerUnit; }
 
     explicit Benchmark(const std::string &name, double factor = 0., const std::string &X = std::string());
     void changeInterpretation(double factor, const char *X);
@@ -97,6 +100,10 @@ public:
     bool wantsMoreDataPoints() const;
     Vc_ALWAYS_INLINE_L bool Start() Vc_ALWAYS_INLINE_R;
     void Mark();
+    /// Pause() and Resume() exclude the time in between from the current data point, e.g. to
+    /// reset the input of the kernel between its parts.
+    Vc_ALWAYS_INLINE_L void Pause() Vc_ALWAYS_INLINE_R;
+    Vc_ALWAYS_INLINE_L void Resume() Vc_ALWAYS_INLINE_R;
     Vc_ALWAYS_INLINE_L void Stop() Vc_ALWAYS_INLINE_R;
     bool Print();
 
@@ -119,9 +126,14 @@ private:
 #endif
     double m_mean[3];
     double m_stddev[3];
+    double m_elapsed[3]; // of the current data point, summed over its Start/Resume..Pause/Stop
     TimeStampCounter fTsc;
     int m_dataPointsCount;
+    std::string m_case;         // --budget: identifies the case across the passes
+    double m_allotment;         // --budget: wall seconds in the final pass
+    double m_caseStart;         // --budget: steady clock seconds at construction
     static FileWriter *s_fileWriter;
+    static double s_lastCyclesPerUnit;
     bool m_skip;
 
     static const char greenEsc  [8];
@@ -131,6 +143,13 @@ private:
 };
 
 Vc_ALWAYS_INLINE bool Benchmark::Start()
+{
+    m_elapsed[0] = m_elapsed[1] = m_elapsed[2] = 0.;
+    Resume();
+    return true;
+}
+
+Vc_ALWAYS_INLINE void Benchmark::Resume()
 {
 #ifdef _MSC_VER
     QueryPerformanceCounter((LARGE_INTEGER *)&fRealTime);
@@ -143,7 +162,6 @@ Vc_ALWAYS_INLINE bool Benchmark::Start()
 #endif
 #endif
     fTsc.Start();
-    return true;
 }
 
 #ifndef _MSC_VER
@@ -153,7 +171,7 @@ static inline double convertTimeSpec(const struct timespec &ts)
 }
 #endif
 
-Vc_ALWAYS_INLINE void Benchmark::Stop()
+Vc_ALWAYS_INLINE void Benchmark::Pause()
 {
     fTsc.Stop();
 #ifdef _MSC_VER
@@ -177,16 +195,25 @@ Vc_ALWAYS_INLINE void Benchmark::Stop()
 #ifdef VC_USE_CPU_TIME
     struct timespec cpu;
     clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &cpu );
-    const double elapsedCpuTime = convertTimeSpec(cpu ) - convertTimeSpec(fCpuTime);
-    m_mean[2] += elapsedCpuTime;
-    m_stddev[2] += elapsedCpuTime * elapsedCpuTime;
+    m_elapsed[2] += convertTimeSpec(cpu ) - convertTimeSpec(fCpuTime);
 #endif
     const double elapsedRealTime = convertTimeSpec(real) - convertTimeSpec(fRealTime);
 #endif
-    m_mean[0] += elapsedRealTime;
-    m_mean[1] += fTsc.Cycles();
-    m_stddev[0] += elapsedRealTime * elapsedRealTime;
-    m_stddev[1] += fTsc.Cycles() * fTsc.Cycles();
+    m_elapsed[0] += elapsedRealTime;
+    m_elapsed[1] += fTsc.Cycles();
+}
+
+Vc_ALWAYS_INLINE void Benchmark::Stop()
+{
+    Pause();
+#ifdef VC_USE_CPU_TIME
+    m_mean[2] += m_elapsed[2];
+    m_stddev[2] += m_elapsed[2] * m_elapsed[2];
+#endif
+    m_mean[0] += m_elapsed[0];
+    m_mean[1] += m_elapsed[1];
+    m_stddev[0] += m_elapsed[0] * m_elapsed[0];
+    m_stddev[1] += m_elapsed[1] * m_elapsed[1];
     ++m_dataPointsCount;
 }
 
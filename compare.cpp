@@ -22,6 +22,12 @@
 #include <Vc/cpuid.h>
 #include <cstdio>
 #include <cstdlib>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#if defined __SSSE3__ || defined __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace Vc;
 using sfloat_v = Vc::SimdArray<float, short_v::size()>;
@@ -35,6 +41,16 @@ static inline void doNothingButDontOptimize()
 #endif
 }
 
+static inline void keepScalarResult(int x)
+{
+#ifdef __GNUC__
+    asm volatile(""::"r"(x));
+#else
+    static volatile int blackHole;
+    blackHole = x;
+#endif
+}
+
 template<typename Vector> class DoCompares
 {
     enum {
@@ -94,12 +110,472 @@ template<typename Vector> class DoCompares
                     if (!(arg2 < arg3).isEmpty()) doNothingButDontOptimize();
                 }
             }
+
+            // mask reductions
+            benchmark_loop(Benchmark("(operator<).count()", Vector::Size * Repetitions * 6.0, "Op")) {
+                for (int i = 0; i < Repetitions; ++i) {
+                    asm("":"+m"(arg0), "+m"(arg1), "+m"(arg2), "+m"(arg3));
+                    keepScalarResult((arg0 < arg1).count());
+                    keepScalarResult((arg0 < arg2).count());
+                    keepScalarResult((arg0 < arg3).count());
+                    keepScalarResult((arg1 < arg2).count());
+                    keepScalarResult((arg1 < arg3).count());
+                    keepScalarResult((arg2 < arg3).count());
+                }
+            }
+            benchmark_loop(Benchmark("(operator<).toInt()", Vector::Size * Repetitions * 6.0, "Op")) {
+                for (int i = 0; i < Repetitions; ++i) {
+                    asm("":"+m"(arg0), "+m"(arg1), "+m"(arg2), "+m"(arg3));
+                    keepScalarResult((arg0 < arg1).toInt());
+                    keepScalarResult((arg0 < arg2).toInt());
+                    keepScalarResult((arg0 < arg3).toInt());
+                    keepScalarResult((arg1 < arg2).toInt());
+                    keepScalarResult((arg1 < arg3).toInt());
+                    keepScalarResult((arg2 < arg3).toInt());
+                }
+            }
+            {
+                // firstOne() requires a non-empty mask: the first lane of argLow compares less
+                // or equal to anything
+                Vector argLow = arg0;
+                argLow[0] = std::numeric_limits<typename Vector::EntryType>::lowest();
+                benchmark_loop(Benchmark("(operator<=).firstOne()", Vector::Size * Repetitions * 3.0, "Op")) {
+                    for (int i = 0; i < Repetitions; ++i) {
+                        asm("":"+m"(argLow), "+m"(arg1), "+m"(arg2), "+m"(arg3));
+                        keepScalarResult((argLow <= arg1).firstOne());
+                        keepScalarResult((argLow <= arg2).firstOne());
+                        keepScalarResult((argLow <= arg3).firstOne());
+                    }
+                }
+            }
+            benchmark_loop(Benchmark("any_of(operator<)", Vector::Size * Repetitions * 6.0, "Op")) {
+                for (int i = 0; i < Repetitions; ++i) {
+                    asm("":"+m"(arg0), "+m"(arg1), "+m"(arg2), "+m"(arg3));
+                    if (Vc::any_of(arg0 < arg1)) doNothingButDontOptimize();
+                    if (Vc::any_of(arg0 < arg2)) doNothingButDontOptimize();
+                    if (Vc::any_of(arg0 < arg3)) doNothingButDontOptimize();
+                    if (Vc::any_of(arg1 < arg2)) doNothingButDontOptimize();
+                    if (Vc::any_of(arg1 < arg3)) doNothingButDontOptimize();
+                    if (Vc::any_of(arg2 < arg3)) doNothingButDontOptimize();
+                }
+            }
+            benchmark_loop(Benchmark("all_of(operator<)", Vector::Size * Repetitions * 6.0, "Op")) {
+                for (int i = 0; i < Repetitions; ++i) {
+                    asm("":"+m"(arg0), "+m"(arg1), "+m"(arg2), "+m"(arg3));
+                    if (Vc::all_of(arg0 < arg1)) doNothingButDontOptimize();
+                    if (Vc::all_of(arg0 < arg2)) doNothingButDontOptimize();
+                    if (Vc::all_of(arg0 < arg3)) doNothingButDontOptimize();
+                    if (Vc::all_of(arg1 < arg2)) doNothingButDontOptimize();
+                    if (Vc::all_of(arg1 < arg3)) doNothingButDontOptimize();
+                    if (Vc::all_of(arg2 < arg3)) doNothingButDontOptimize();
+                }
+            }
+            benchmark_loop(Benchmark("none_of(operator<)", Vector::Size * Repetitions * 6.0, "Op")) {
+                for (int i = 0; i < Repetitions; ++i) {
+                    asm("":"+m"(arg0), "+m"(arg1), "+m"(arg2), "+m"(arg3));
+                    if (Vc::none_of(arg0 < arg1)) doNothingButDontOptimize();
+                    if (Vc::none_of(arg0 < arg2)) doNothingButDontOptimize();
+                    if (Vc::none_of(arg0 < arg3)) doNothingButDontOptimize();
+                    if (Vc::none_of(arg1 < arg2)) doNothingButDontOptimize();
+                    if (Vc::none_of(arg1 < arg3)) doNothingButDontOptimize();
+                    if (Vc::none_of(arg2 < arg3)) doNothingButDontOptimize();
+                }
+            }
         }
 };
 
+/**
+ * Shuffles N lanes of Bytes bytes each with a table lookup (indexed by the mask bits) of the
+ * permutation. Only implemented where the instruction set has a suitable permute.
+ */
+template <int N, int Bytes> struct PermuteTable
+{
+    enum { Available = false, PdepAvailable = false };
+    static void compress(const void *, int, void *) {}
+    static void expand(const void *, int, void *) {}
+    static void compressPdep(const void *, int, void *) {}
+    static void expandPdep(const void *, int, void *) {}
+};
+
+#if defined __SSSE3__ && !defined __AVX2__
+template <> struct PermuteTable<4, 4>
+{
+    enum { Available = true, PdepAvailable = false };
+    struct Tables {
+        __m128i compress[16];
+        __m128i expand[16];
+        Tables()
+        {
+            for (int bits = 0; bits < 16; ++bits) {
+                alignas(16) unsigned char c[16], e[16];
+                std::memset(c, 0x80, 16);  // pshufb zeroes bytes with the high bit set
+                std::memset(e, 0x80, 16);
+                int n = 0;
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (bits & (1 << lane)) {
+                        for (int b = 0; b < 4; ++b) {
+                            c[n * 4 + b] = lane * 4 + b;
+                            e[lane * 4 + b] = n * 4 + b;
+                        }
+                        ++n;
+                    }
+                }
+                compress[bits] = _mm_load_si128(reinterpret_cast<const __m128i *>(c));
+                expand[bits] = _mm_load_si128(reinterpret_cast<const __m128i *>(e));
+            }
+        }
+    };
+    static const Tables &tables() { static const Tables t; return t; }
+
+    static Vc_ALWAYS_INLINE void compress(const void *in, int bits, void *out)
+    {
+        const __m128i v = _mm_loadu_si128(static_cast<const __m128i *>(in));
+        _mm_storeu_si128(static_cast<__m128i *>(out), _mm_shuffle_epi8(v, tables().compress[bits]));
+    }
+    static Vc_ALWAYS_INLINE void expand(const void *in, int bits, void *out)
+    {
+        const __m128i v = _mm_loadu_si128(static_cast<const __m128i *>(in));
+        _mm_storeu_si128(static_cast<__m128i *>(out), _mm_shuffle_epi8(v, tables().expand[bits]));
+    }
+    static void compressPdep(const void *, int, void *) {}
+    static void expandPdep(const void *, int, void *) {}
+};
+#endif
+
+#ifdef __AVX2__
+template <> struct PermuteTable<8, 4>
+{
+#ifdef __BMI2__
+    enum { Available = true, PdepAvailable = true };
+#else
+    enum { Available = true, PdepAvailable = false };
+#endif
+    struct Tables {
+        __m256i compress[256];
+        __m256i expand[256];
+        Tables()
+        {
+            for (int bits = 0; bits < 256; ++bits) {
+                alignas(32) int c[8] = {}, e[8] = {};
+                int n = 0;
+                for (int lane = 0; lane < 8; ++lane) {
+                    if (bits & (1 << lane)) {
+                        c[n] = lane;
+                        e[lane] = n;
+                        ++n;
+                    }
+                }
+                compress[bits] = _mm256_load_si256(reinterpret_cast<const __m256i *>(c));
+                expand[bits] = _mm256_load_si256(reinterpret_cast<const __m256i *>(e));
+            }
+        }
+    };
+    static const Tables &tables() { static const Tables t; return t; }
+
+    // all bits set in the lanes selected by bits
+    static Vc_ALWAYS_INLINE __m256i laneMask(int bits)
+    {
+        const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), laneBits), laneBits);
+    }
+
+    static Vc_ALWAYS_INLINE void compress(const void *in, int bits, void *out)
+    {
+        const __m256i v = _mm256_loadu_si256(static_cast<const __m256i *>(in));
+        _mm256_storeu_si256(static_cast<__m256i *>(out),
+                            _mm256_permutevar8x32_epi32(v, tables().compress[bits]));
+    }
+    static Vc_ALWAYS_INLINE void expand(const void *in, int bits, void *out)
+    {
+        const __m256i v = _mm256_loadu_si256(static_cast<const __m256i *>(in));
+        _mm256_storeu_si256(static_cast<__m256i *>(out),
+                            _mm256_and_si256(_mm256_permutevar8x32_epi32(v, tables().expand[bits]),
+                                             laneMask(bits)));
+    }
+
+#ifdef __BMI2__
+    // the permutation is computed instead of loaded: pext/pdep of the byte indexes 0..7 with one
+    // byte per selected lane
+    static Vc_ALWAYS_INLINE void compressPdep(const void *in, int bits, void *out)
+    {
+        const unsigned long long selected = _pdep_u64(bits, 0x0101010101010101ull) * 0xff;
+        const __m256i perm = _mm256_cvtepu8_epi32(
+            _mm_cvtsi64_si128(_pext_u64(0x0706050403020100ull, selected)));
+        const __m256i v = _mm256_loadu_si256(static_cast<const __m256i *>(in));
+        _mm256_storeu_si256(static_cast<__m256i *>(out), _mm256_permutevar8x32_epi32(v, perm));
+    }
+    static Vc_ALWAYS_INLINE void expandPdep(const void *in, int bits, void *out)
+    {
+        const unsigned long long selected = _pdep_u64(bits, 0x0101010101010101ull) * 0xff;
+        const __m256i perm = _mm256_cvtepu8_epi32(
+            _mm_cvtsi64_si128(_pdep_u64(0x0706050403020100ull, selected)));
+        const __m256i v = _mm256_loadu_si256(static_cast<const __m256i *>(in));
+        _mm256_storeu_si256(static_cast<__m256i *>(out),
+                            _mm256_and_si256(_mm256_permutevar8x32_epi32(v, perm), laneMask(bits)));
+    }
+#else
+    static void compressPdep(const void *, int, void *) {}
+    static void expandPdep(const void *, int, void *) {}
+#endif
+};
+#endif
+
+/**
+ * Stream compaction: write the elements for which the predicate is true contiguously to the
+ * output (compress), and the inverse, distributing contiguous input to the selected lanes
+ * (expand).
+ */
+template<typename Vector> class StreamCompaction
+{
+    typedef typename Vector::EntryType Scalar;
+    typedef typename Vector::Mask Mask;
+    typedef typename Vector::IndexType IndexType;
+    typedef PermuteTable<Vector::Size, sizeof(Scalar)> Permute;
+
+    enum {
+        Size = 1024 * 1024
+    };
+
+    Scalar *const m_in;
+    Scalar *const m_compressed;
+    Scalar *const m_expanded;
+    std::vector<int> m_compressIndexes;
+    std::vector<int> m_expandIndexes;
+    std::vector<Scalar> m_referenceCompressed;
+    std::vector<Scalar> m_referenceExpanded;
+    Scalar m_threshold;
+
+    static Scalar fromRandomBits(unsigned int bits)
+    {
+        // [0, 1) for floating point, [0, 2^24) for integers
+        return std::is_floating_point<Scalar>::value ? Scalar(bits * (1. / (1 << 24))) : Scalar(bits);
+    }
+
+public:
+    StreamCompaction()
+        : m_in(Vc::malloc<Scalar, Vc::AlignOnPage>(Size)),
+          // the vector stores write up to one vector past the compacted elements
+          m_compressed(Vc::malloc<Scalar, Vc::AlignOnPage>(Size + Vector::Size)),
+          m_expanded(Vc::malloc<Scalar, Vc::AlignOnPage>(Size)),
+          m_compressIndexes((1 << Vector::Size) * Vector::Size, 0),
+          m_expandIndexes((1 << Vector::Size) * Vector::Size, 0)
+    {
+        unsigned int state = 0x9e3779b9u;
+        for (int i = 0; i < Size; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            m_in[i] = fromRandomBits(state >> 8);
+        }
+        for (int bits = 0; bits < (1 << Vector::Size); ++bits) {
+            int n = 0;
+            for (int lane = 0; lane < int(Vector::Size); ++lane) {
+                if (bits & (1 << lane)) {
+                    m_compressIndexes[bits * Vector::Size + n] = lane;
+                    m_expandIndexes[bits * Vector::Size + lane] = n;
+                    ++n;
+                }
+            }
+        }
+    }
+
+    ~StreamCompaction()
+    {
+        Vc::free(m_in);
+        Vc::free(m_compressed);
+        Vc::free(m_expanded);
+    }
+
+    static void run()/*{{{*/
+    {
+        static const double selectivities[] = { 0., .01, .1, .25, .5, .75, .9, .99, 1. };
+        StreamCompaction bench;
+        for (double selectivity : selectivities) {
+            std::ostringstream name;
+            name << selectivity * 100. << '%';
+            Benchmark::setColumnData("selectivity", name.str());
+            bench.setSelectivity(selectivity);
+            bench.runCompress();
+            bench.runExpand();
+        }
+        Benchmark::setColumnData("selectivity", "n/a");
+    }/*}}}*/
+
+private:
+    void setSelectivity(double selectivity)/*{{{*/
+    {
+        m_threshold = fromRandomBits(static_cast<unsigned int>(selectivity * (1 << 24)));
+        m_referenceCompressed.clear();
+        m_referenceExpanded.assign(Size, Scalar(0));
+        for (int i = 0; i < Size; ++i) {
+            if (m_in[i] < m_threshold) {
+                m_referenceExpanded[i] = m_in[i];
+                m_referenceCompressed.push_back(m_in[i]);
+            }
+        }
+    }/*}}}*/
+
+    void verify(const char *name, const Scalar *result, const std::vector<Scalar> &reference, int n)/*{{{*/
+    {
+        if (n != int(reference.size()) || !std::equal(reference.begin(), reference.end(), result)) {
+            std::cerr << name << " produced a wrong result!" << std::endl;
+        }
+    }/*}}}*/
+
+    template <typename F> void benchmarkCompress(const char *name, F &&kernel)/*{{{*/
+    {
+        int n = 0;
+        benchmark_loop(Benchmark(name, Size, "Element")) {
+            n = kernel();
+        }
+        verify(name, m_compressed, m_referenceCompressed, n);
+    }
+
+    template <typename F> void benchmarkExpand(const char *name, F &&kernel)
+    {
+        std::copy(m_referenceCompressed.begin(), m_referenceCompressed.end(), m_compressed);
+        int n = 0;
+        benchmark_loop(Benchmark(name, Size, "Element")) {
+            n = kernel();
+        }
+        verify(name, m_expanded, m_referenceExpanded, Size);
+        if (n != int(m_referenceCompressed.size())) {
+            std::cerr << name << " consumed a wrong number of elements!" << std::endl;
+        }
+    }/*}}}*/
+
+    void runCompress()/*{{{*/
+    {
+        const Scalar t = m_threshold;
+        const Vector tv(m_threshold);
+        benchmarkCompress("compress: scalar (branch)", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; ++i) {
+                if (m_in[i] < t) {
+                    m_compressed[n++] = m_in[i];
+                }
+            }
+            return n;
+        });
+        benchmarkCompress("compress: scalar (branchless)", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; ++i) {
+                const Scalar x = m_in[i];
+                m_compressed[n] = x;
+                n += x < t;
+            }
+            return n;
+        });
+        benchmarkCompress("compress: table + gather", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; i += Vector::Size) {
+                const Mask m = Vector(&m_in[i], Vc::Aligned) < tv;
+                const IndexType perm(&m_compressIndexes[m.toInt() * Vector::Size], Vc::Unaligned);
+                Vector(&m_in[i], perm).store(&m_compressed[n], Vc::Unaligned);
+                n += m.count();
+            }
+            return n;
+        });
+        runCompressPermute(std::integral_constant<bool, Permute::Available>());
+    }
+
+    void runCompressPermute(std::false_type) {}
+    void runCompressPermute(std::true_type)
+    {
+        const Vector tv(m_threshold);
+        benchmarkCompress("compress: table + permute", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; i += Vector::Size) {
+                const Mask m = Vector(&m_in[i], Vc::Aligned) < tv;
+                Permute::compress(&m_in[i], m.toInt(), &m_compressed[n]);
+                n += m.count();
+            }
+            return n;
+        });
+        if (Permute::PdepAvailable) {
+            benchmarkCompress("compress: pext + permute", [&]() {
+                int n = 0;
+                for (int i = 0; i < Size; i += Vector::Size) {
+                    const Mask m = Vector(&m_in[i], Vc::Aligned) < tv;
+                    Permute::compressPdep(&m_in[i], m.toInt(), &m_compressed[n]);
+                    n += m.count();
+                }
+                return n;
+            });
+        }
+    }/*}}}*/
+
+    void runExpand()/*{{{*/
+    {
+        const Scalar t = m_threshold;
+        const Vector tv(m_threshold);
+        benchmarkExpand("expand: scalar (branch)", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; ++i) {
+                if (m_in[i] < t) {
+                    m_expanded[i] = m_compressed[n++];
+                } else {
+                    m_expanded[i] = Scalar(0);
+                }
+            }
+            return n;
+        });
+        benchmarkExpand("expand: scalar (branchless)", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; ++i) {
+                const bool selected = m_in[i] < t;
+                m_expanded[i] = selected ? m_compressed[n] : Scalar(0);
+                n += selected;
+            }
+            return n;
+        });
+        benchmarkExpand("expand: table + gather", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; i += Vector::Size) {
+                const Mask m = Vector(&m_in[i], Vc::Aligned) < tv;
+                const IndexType perm(&m_expandIndexes[m.toInt() * Vector::Size], Vc::Unaligned);
+                Vector x(Vc::Zero);
+                x.gather(&m_compressed[n], perm, m);
+                x.store(&m_expanded[i], Vc::Aligned);
+                n += m.count();
+            }
+            return n;
+        });
+        runExpandPermute(std::integral_constant<bool, Permute::Available>());
+    }
+
+    void runExpandPermute(std::false_type) {}
+    void runExpandPermute(std::true_type)
+    {
+        const Vector tv(m_threshold);
+        benchmarkExpand("expand: table + permute", [&]() {
+            int n = 0;
+            for (int i = 0; i < Size; i += Vector::Size) {
+                const Mask m = Vector(&m_in[i], Vc::Aligned) < tv;
+                Permute::expand(&m_compressed[n], m.toInt(), &m_expanded[i]);
+                n += m.count();
+            }
+            return n;
+        });
+        if (Permute::PdepAvailable) {
+            benchmarkExpand("expand: pdep + permute", [&]() {
+                int n = 0;
+                for (int i = 0; i < Size; i += Vector::Size) {
+                    const Mask m = Vector(&m_in[i], Vc::Aligned) < tv;
+                    Permute::expandPdep(&m_compressed[n], m.toInt(), &m_expanded[i]);
+                    n += m.count();
+                }
+                return n;
+            });
+        }
+    }/*}}}*/
+};
+
 int bmain()
 {
     Benchmark::addColumn("datatype");
+    Benchmark::addColumn("selectivity");
+    Benchmark::setColumnData("selectivity", "n/a");
 
     Benchmark::setColumnData("datatype", "double_v");
     DoCompares<double_v>::run();
@@ -116,5 +592,12 @@ int bmain()
     Benchmark::setColumnData("datatype", "sfloat_v");
     DoCompares<sfloat_v>::run();
 
+    Benchmark::setColumnData("datatype", "float_v");
+    StreamCompaction<float_v>::run();
+    Benchmark::setColumnData("datatype", "int_v");
+    StreamCompaction<int_v>::run();
+    Benchmark::setColumnData("datatype", "double_v");
+    StreamCompaction<double_v>::run();
+
     return 0;
 }
@@ -18,288 +18,417 @@
 */
 
 #include <Vc/Vc>
-#include <emmintrin.h>
 #include "benchmark.h"
 
 #include <cstdlib>
+#include <type_traits>
 
 using namespace Vc;
 
-static const unsigned int allone[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
-static const unsigned int absMask[4] = { 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff };
-
-__m128 blackHole = _mm_setzero_ps();
+/*
+ * Compares the ways to get a constant into a vector register: generating it from all-ones with
+ * ALU instructions, loading the full vector, loading 4 bytes and broadcasting them, or moving an
+ * immediate through a general purpose register. The consumer of the constant is either nothing
+ * (all ones), an and (abs mask), or an xor (inversion, sign mask). In the "data loads" variants
+ * every constant competes with two loads of L1 resident data for the load ports.
+ *
+ * The asm kernels exist for xmm (all targets on x86) and ymm registers (if the target enables
+ * AVX). The last part measures what the compiler makes of the constants in the Vc API under low
+ * and high register pressure.
+ */
 
 enum {
-    Factor = 512000
+    Factor = 512000,
+    Accumulators = 4,
+    DataSize = 1024
 };
 
-int bmain()
+template <unsigned int C> struct Constant
+{
+    alignas(32) static const unsigned int data[8];
+};
+template <unsigned int C> alignas(32) const unsigned int Constant<C>::data[8] = { C, C, C, C, C, C, C, C };
+
+enum : unsigned int {
+    AllOnes = 0xffffffffu,
+    AbsMask = 0x7fffffffu,
+    SignMask = 0x80000000u
+};
+
+alignas(32) static float g_data[DataSize];
+
+#if defined __GNUC__ && defined __SSE2__
+#ifdef __AVX__
+#define SSE_OR_VEX(sse_, vex_) vex_
+#else
+#define SSE_OR_VEX(sse_, vex_) sse_
+#endif
+
+// register types/*{{{*/
+typedef std::integral_constant<unsigned int, AllOnes> AllOnesTag;
+typedef std::integral_constant<unsigned int, AbsMask> AbsMaskTag;
+typedef std::integral_constant<unsigned int, SignMask> SignMaskTag;
+
+struct Xmm
 {
+    typedef __m128 R;
+    static const char *name() { return "xmm"; }
+    static Vc_ALWAYS_INLINE R zero() { return _mm_setzero_ps(); }
+    static Vc_ALWAYS_INLINE void keep(R x) { asm volatile("" ::"x"(x)); }
+
+    static Vc_ALWAYS_INLINE R generated(AllOnesTag)
     {
-        Benchmark timer("constant, shuffled one", Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("mov $0xffffffff,%%eax" :::"eax");
-                asm volatile("movd %%eax,%%xmm0" :::"xmm0", "eax");
-                asm volatile("pshufd $0,%%xmm0,%%xmm0" :::"xmm0");
-            }
-            timer.Stop();
-        }
-        timer.Print();
+        R r;
+        asm volatile(SSE_OR_VEX("pcmpeqd %0,%0", "vpcmpeqd %0,%0,%0") : "=x"(r));
+        return r;
     }
+    static Vc_ALWAYS_INLINE R generated(AbsMaskTag)
     {
-        Benchmark timer("load 4 bytes, shuffled one", Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("movss %0,%%xmm0" ::"m"(allone[0]):"xmm0");
-                asm volatile("shufps $0,%%xmm0,%%xmm0" :::"xmm0");
-            }
-            timer.Stop();
-        }
-        timer.Print();
+        R r;
+        asm volatile(SSE_OR_VEX("pcmpeqd %0,%0\n\tpsrld $1,%0", "vpcmpeqd %0,%0,%0\n\tvpsrld $1,%0,%0") : "=x"(r));
+        return r;
     }
+    static Vc_ALWAYS_INLINE R generated(SignMaskTag)
     {
-        Benchmark timer("generated one", Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("pcmpeqw %%xmm0,%%xmm0" :::"xmm0");
-            }
-            timer.Stop();
-        }
-        timer.Print();
+        R r;
+        asm volatile(SSE_OR_VEX("pcmpeqd %0,%0\n\tpslld $31,%0", "vpcmpeqd %0,%0,%0\n\tvpslld $31,%0,%0") : "=x"(r));
+        return r;
     }
+    template <unsigned int C> static Vc_ALWAYS_INLINE R loaded()
     {
-        Benchmark timer("loaded one", Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            for (int i = 0; i < Factor; ++i) {
-                register __m128 tmp;
-                asm volatile("movaps %1,%0" : "=x"(tmp) : "m"(allone[0]));
-            }
-            timer.Stop();
-        }
-        timer.Print();
+        R r;
+        asm volatile(SSE_OR_VEX("movaps %1,%0", "vmovaps %1,%0") : "=x"(r) : "m"(*reinterpret_cast<const R *>(Constant<C>::data)));
+        return r;
+    }
+    template <unsigned int C> static Vc_ALWAYS_INLINE R broadcast()
+    {
+        R r;
+        asm volatile(SSE_OR_VEX("movss %1,%0\n\tshufps $0,%0,%0", "vbroadcastss %1,%0") : "=x"(r) : "m"(Constant<C>::data[0]));
+        return r;
+    }
+    template <unsigned int C> static Vc_ALWAYS_INLINE R immediate()
+    {
+        R r;
+        asm volatile("movl %1,%%eax\n\t" SSE_OR_VEX("movd %%eax,%0\n\tpshufd $0,%0,%0", "vmovd %%eax,%0\n\tvpshufd $0,%0,%0")
+                     : "=x"(r) : "i"(C) : "eax");
+        return r;
+    }
+    static Vc_ALWAYS_INLINE void load(const float *mem)
+    {
+        R r;
+        asm volatile(SSE_OR_VEX("movaps %1,%0", "vmovaps %1,%0") : "=x"(r) : "m"(*reinterpret_cast<const R *>(mem)));
     }
 
+    static Vc_ALWAYS_INLINE R and_(R a, R b) { return _mm_and_ps(a, b); }
+    static Vc_ALWAYS_INLINE R xor_(R a, R b) { return _mm_xor_ps(a, b); }
+    template <unsigned int C> static Vc_ALWAYS_INLINE void andMemory(R &a)
     {
-        Benchmark timer("constant, shuffled abs", 4 * Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            asm volatile("xorps %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("xorps %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("xorps %%xmm5,%%xmm5" :::"xmm5");
-            asm volatile("xorps %%xmm7,%%xmm7" :::"xmm7");
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("mov $0x7fffffff,%%eax" :::"eax");
-                asm volatile("movd %%eax,%%xmm0" :::"xmm0", "eax");
-                asm volatile("pshufd $0,%%xmm0,%%xmm0" :::"xmm0");
-                asm volatile("pand %%xmm0,%%xmm1" :::"xmm0", "xmm1");
-
-                asm volatile("mov $0x7fffffff,%%ecx" :::"ecx");
-                asm volatile("movd %%ecx,%%xmm2" :::"xmm2", "ecx");
-                asm volatile("pshufd $0,%%xmm2,%%xmm2" :::"xmm2");
-                asm volatile("pand %%xmm2,%%xmm3" :::"xmm2", "xmm3");
-
-                asm volatile("mov $0x7fffffff,%%edx" :::"edx");
-                asm volatile("movd %%edx,%%xmm4" :::"xmm4", "edx");
-                asm volatile("pshufd $0,%%xmm4,%%xmm4" :::"xmm4");
-                asm volatile("pand %%xmm4,%%xmm5" :::"xmm4", "xmm5");
-
-                asm volatile("mov $0x7fffffff,%%esi" :::"esi");
-                asm volatile("movd %%esi,%%xmm6" :::"xmm6", "esi");
-                asm volatile("pshufd $0,%%xmm6,%%xmm6" :::"xmm6");
-                asm volatile("pand %%xmm6,%%xmm7" :::"xmm6", "xmm7");
-            }
-            timer.Stop();
-        }
-        timer.Print();
+        asm volatile(SSE_OR_VEX("andps %1,%0", "vandps %1,%0,%0") : "+x"(a) : "m"(*reinterpret_cast<const R *>(Constant<C>::data)));
     }
+    template <unsigned int C> static Vc_ALWAYS_INLINE void xorMemory(R &a)
     {
-        Benchmark timer("load 4 bytes, shuffled abs", 4 * Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            asm volatile("xorps %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("xorps %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("xorps %%xmm5,%%xmm5" :::"xmm5");
-            asm volatile("xorps %%xmm7,%%xmm7" :::"xmm7");
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("movss %0,%%xmm0" ::"m"(absMask[0]):"xmm0");
-                asm volatile("shufps $0,%%xmm0,%%xmm0" :::"xmm0");
-                asm volatile("pand %%xmm0,%%xmm1" :::"xmm0", "xmm1");
+        asm volatile(SSE_OR_VEX("xorps %1,%0", "vxorps %1,%0,%0") : "+x"(a) : "m"(*reinterpret_cast<const R *>(Constant<C>::data)));
+    }
+};
 
-                asm volatile("movss %0,%%xmm2" ::"m"(absMask[0]):"xmm2");
-                asm volatile("shufps $0,%%xmm2,%%xmm2" :::"xmm2");
-                asm volatile("pand %%xmm2,%%xmm3" :::"xmm2", "xmm3");
+#ifdef __AVX__
+struct Ymm
+{
+    typedef __m256 R;
+    static const char *name() { return "ymm"; }
+    static Vc_ALWAYS_INLINE R zero() { return _mm256_setzero_ps(); }
+    static Vc_ALWAYS_INLINE void keep(R x) { asm volatile("" ::"x"(x)); }
 
-                asm volatile("movss %0,%%xmm4" ::"m"(absMask[0]):"xmm4");
-                asm volatile("shufps $0,%%xmm4,%%xmm4" :::"xmm4");
-                asm volatile("pand %%xmm4,%%xmm5" :::"xmm4", "xmm5");
+#ifdef __AVX2__
+    static Vc_ALWAYS_INLINE R generated(AllOnesTag)
+    {
+        R r;
+        asm volatile("vpcmpeqd %0,%0,%0" : "=x"(r));
+        return r;
+    }
+    static Vc_ALWAYS_INLINE R generated(AbsMaskTag)
+    {
+        R r;
+        asm volatile("vpcmpeqd %0,%0,%0\n\tvpsrld $1,%0,%0" : "=x"(r));
+        return r;
+    }
+    static Vc_ALWAYS_INLINE R generated(SignMaskTag)
+    {
+        R r;
+        asm volatile("vpcmpeqd %0,%0,%0\n\tvpslld $31,%0,%0" : "=x"(r));
+        return r;
+    }
+    template <unsigned int C> static Vc_ALWAYS_INLINE R immediate()
+    {
+        R r;
+        asm volatile("movl %1,%%eax\n\tvmovd %%eax,%x0\n\tvpbroadcastd %x0,%0" : "=x"(r) : "i"(C) : "eax");
+        return r;
+    }
+#else
+    // AVX without AVX2 has no integer instructions on ymm: compare with the "true" predicate or
+    // build the xmm half and duplicate it
+    static Vc_ALWAYS_INLINE R generated(AllOnesTag)
+    {
+        R r;
+        asm volatile("vcmpps $15,%0,%0,%0" : "=x"(r));
+        return r;
+    }
+    static Vc_ALWAYS_INLINE R generated(AbsMaskTag)
+    {
+        R r;
+        asm volatile("vpcmpeqd %x0,%x0,%x0\n\tvpsrld $1,%x0,%x0\n\tvinsertf128 $1,%x0,%0,%0" : "=x"(r));
+        return r;
+    }
+    static Vc_ALWAYS_INLINE R generated(SignMaskTag)
+    {
+        R r;
+        asm volatile("vpcmpeqd %x0,%x0,%x0\n\tvpslld $31,%x0,%x0\n\tvinsertf128 $1,%x0,%0,%0" : "=x"(r));
+        return r;
+    }
+    template <unsigned int C> static Vc_ALWAYS_INLINE R immediate()
+    {
+        R r;
+        asm volatile("movl %1,%%eax\n\tvmovd %%eax,%x0\n\tvpshufd $0,%x0,%x0\n\tvinsertf128 $1,%x0,%0,%0"
+                     : "=x"(r) : "i"(C) : "eax");
+        return r;
+    }
+#endif
+    template <unsigned int C> static Vc_ALWAYS_INLINE R loaded()
+    {
+        R r;
+        asm volatile("vmovaps %1,%0" : "=x"(r) : "m"(*reinterpret_cast<const R *>(Constant<C>::data)));
+        return r;
+    }
+    template <unsigned int C> static Vc_ALWAYS_INLINE R broadcast()
+    {
+        R r;
+        asm volatile("vbroadcastss %1,%0" : "=x"(r) : "m"(Constant<C>::data[0]));
+        return r;
+    }
+    static Vc_ALWAYS_INLINE void load(const float *mem)
+    {
+        R r;
+        asm volatile("vmovaps %1,%0" : "=x"(r) : "m"(*reinterpret_cast<const R *>(mem)));
+    }
 
-                asm volatile("movss %0,%%xmm6" ::"m"(absMask[0]):"xmm6");
-                asm volatile("shufps $0,%%xmm6,%%xmm6" :::"xmm6");
-                asm volatile("pand %%xmm6,%%xmm7" :::"xmm6", "xmm7");
-            }
-            timer.Stop();
-        }
-        timer.Print();
+    static Vc_ALWAYS_INLINE R and_(R a, R b) { return _mm256_and_ps(a, b); }
+    static Vc_ALWAYS_INLINE R xor_(R a, R b) { return _mm256_xor_ps(a, b); }
+    template <unsigned int C> static Vc_ALWAYS_INLINE void andMemory(R &a)
+    {
+        asm volatile("vandps %1,%0,%0" : "+x"(a) : "m"(*reinterpret_cast<const R *>(Constant<C>::data)));
     }
+    template <unsigned int C> static Vc_ALWAYS_INLINE void xorMemory(R &a)
     {
-        Benchmark timer("generated abs", 4 * Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            asm volatile("xorps %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("xorps %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("xorps %%xmm5,%%xmm5" :::"xmm5");
-            asm volatile("xorps %%xmm7,%%xmm7" :::"xmm7");
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("pcmpeqw %%xmm0,%%xmm0" :::"xmm0");
-                asm volatile("psrld $1,%%xmm0" :::"xmm0");
-                asm volatile("pand %%xmm0,%%xmm1" :::"xmm0", "xmm1");
+        asm volatile("vxorps %1,%0,%0" : "+x"(a) : "m"(*reinterpret_cast<const R *>(Constant<C>::data)));
+    }
+};
+#endif
+/*}}}*/
+
+// consumers of the constant/*{{{*/
+struct NoUse
+{
+    enum { HasMemoryOperand = false };
+    template <typename Reg> static Vc_ALWAYS_INLINE void use(typename Reg::R &, typename Reg::R c) { Reg::keep(c); }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE void useMemory(typename Reg::R &) {}
+};
+struct And
+{
+    enum { HasMemoryOperand = true };
+    template <typename Reg> static Vc_ALWAYS_INLINE void use(typename Reg::R &acc, typename Reg::R c) { acc = Reg::and_(acc, c); }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE void useMemory(typename Reg::R &acc) { Reg::template andMemory<C>(acc); }
+};
+struct Xor
+{
+    enum { HasMemoryOperand = true };
+    template <typename Reg> static Vc_ALWAYS_INLINE void use(typename Reg::R &acc, typename Reg::R c) { acc = Reg::xor_(acc, c); }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE void useMemory(typename Reg::R &acc) { Reg::template xorMemory<C>(acc); }
+};/*}}}*/
 
-                asm volatile("pcmpeqw %%xmm2,%%xmm2" :::"xmm2");
-                asm volatile("psrld $1,%%xmm2" :::"xmm2");
-                asm volatile("pand %%xmm2,%%xmm3" :::"xmm2", "xmm3");
+// ways to materialize the constant/*{{{*/
+struct Generated
+{
+    static const char *name() { return "generated"; }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE typename Reg::R make()
+    {
+        return Reg::generated(std::integral_constant<unsigned int, C>());
+    }
+};
+struct Loaded
+{
+    static const char *name() { return "loaded"; }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE typename Reg::R make() { return Reg::template loaded<C>(); }
+};
+struct Broadcast
+{
+    static const char *name() { return "load 4 bytes, broadcast"; }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE typename Reg::R make() { return Reg::template broadcast<C>(); }
+};
+struct Immediate
+{
+    static const char *name() { return "immediate, broadcast"; }
+    template <typename Reg, unsigned int C> static Vc_ALWAYS_INLINE typename Reg::R make() { return Reg::template immediate<C>(); }
+};/*}}}*/
 
-                asm volatile("pcmpeqw %%xmm4,%%xmm4" :::"xmm4");
-                asm volatile("psrld $1,%%xmm4" :::"xmm4");
-                asm volatile("pand %%xmm4,%%xmm5" :::"xmm4", "xmm5");
+template <typename Reg, unsigned int C, typename Use> struct Materialization/*{{{*/
+{
+    typedef typename Reg::R R;
 
-                asm volatile("pcmpeqw %%xmm6,%%xmm6" :::"xmm6");
-                asm volatile("psrld $1,%%xmm6" :::"xmm6");
-                asm volatile("pand %%xmm6,%%xmm7" :::"xmm6", "xmm7");
-            }
-            timer.Stop();
+    template <int DataLoads> static Vc_ALWAYS_INLINE void loadData(int i)
+    {
+        enum { Stride = sizeof(R) / sizeof(float) };
+        for (int n = 0; n < DataLoads; ++n) {
+            Reg::load(&g_data[((i * DataLoads + n) * Stride) % DataSize]);
         }
-        timer.Print();
     }
+
+    template <typename Make, int DataLoads> static void measure()
     {
-        Benchmark timer("loaded abs", 4 * Factor, "Op");
+        Benchmark timer(Make::name(), Accumulators * Factor, "Op");
         while (timer.wantsMoreDataPoints()) {
+            R acc[Accumulators];
+            for (int k = 0; k < Accumulators; ++k) {
+                acc[k] = Reg::zero();
+            }
             timer.Start();
-            asm volatile("xorps %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("xorps %%xmm2,%%xmm2" :::"xmm2");
-            asm volatile("xorps %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("xorps %%xmm4,%%xmm4" :::"xmm4");
             for (int i = 0; i < Factor; ++i) {
-                asm volatile("pand %0,%%xmm1" :: "m"(absMask[0]) :"xmm1");
-                asm volatile("pand %0,%%xmm2" :: "m"(absMask[0]) :"xmm2");
-                asm volatile("pand %0,%%xmm3" :: "m"(absMask[0]) :"xmm3");
-                asm volatile("pand %0,%%xmm4" :: "m"(absMask[0]) :"xmm4");
+                for (int k = 0; k < Accumulators; ++k) {
+                    Use::template use<Reg>(acc[k], Make::template make<Reg, C>());
+                    loadData<DataLoads>(i * Accumulators + k);
+                }
             }
             timer.Stop();
+            for (int k = 0; k < Accumulators; ++k) {
+                Reg::keep(acc[k]);
+            }
         }
         timer.Print();
     }
 
+    template <int DataLoads> static void measureMemoryOperand(std::true_type)
     {
-        Benchmark timer("constant, shuffled inversion", 4 * Factor, "Op");
+        Benchmark timer("memory operand", Accumulators * Factor, "Op");
         while (timer.wantsMoreDataPoints()) {
+            R acc[Accumulators];
+            for (int k = 0; k < Accumulators; ++k) {
+                acc[k] = Reg::zero();
+            }
             timer.Start();
-            asm volatile("pxor %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("pxor %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("pxor %%xmm5,%%xmm5" :::"xmm5");
-            asm volatile("pxor %%xmm7,%%xmm7" :::"xmm7");
             for (int i = 0; i < Factor; ++i) {
-                asm volatile("mov $0xffffffff,%%eax" :::"eax");
-                asm volatile("movd %%eax,%%xmm0" :::"xmm0", "eax");
-                asm volatile("pshufd $0,%%xmm0,%%xmm0" :::"xmm0");
-                asm volatile("pxor %%xmm0,%%xmm1" :::"xmm0", "xmm1");
-
-                asm volatile("mov $0xffffffff,%%ecx" :::"ecx");
-                asm volatile("movd %%ecx,%%xmm2" :::"xmm2", "ecx");
-                asm volatile("pshufd $0,%%xmm2,%%xmm2" :::"xmm2");
-                asm volatile("pxor %%xmm2,%%xmm3" :::"xmm2", "xmm3");
-
-                asm volatile("mov $0xffffffff,%%edx" :::"edx");
-                asm volatile("movd %%edx,%%xmm4" :::"xmm4", "edx");
-                asm volatile("pshufd $0,%%xmm4,%%xmm4" :::"xmm4");
-                asm volatile("pxor %%xmm4,%%xmm5" :::"xmm4", "xmm5");
-
-                asm volatile("mov $0xffffffff,%%esi" :::"esi");
-                asm volatile("movd %%esi,%%xmm6" :::"xmm6", "esi");
-                asm volatile("pshufd $0,%%xmm6,%%xmm6" :::"xmm6");
-                asm volatile("pxor %%xmm6,%%xmm7" :::"xmm6", "xmm7");
+                for (int k = 0; k < Accumulators; ++k) {
+                    Use::template useMemory<Reg, C>(acc[k]);
+                    loadData<DataLoads>(i * Accumulators + k);
+                }
             }
             timer.Stop();
+            for (int k = 0; k < Accumulators; ++k) {
+                Reg::keep(acc[k]);
+            }
         }
         timer.Print();
     }
-    {
-        Benchmark timer("load 4 bytes, shuffled inversion", 4 * Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            asm volatile("xorps %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("xorps %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("xorps %%xmm5,%%xmm5" :::"xmm5");
-            asm volatile("xorps %%xmm7,%%xmm7" :::"xmm7");
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("movss %0,%%xmm0" ::"m"(allone[0]):"xmm0");
-                asm volatile("shufps $0,%%xmm0,%%xmm0" :::"xmm0");
-                asm volatile("xorps %%xmm0,%%xmm1" :::"xmm0", "xmm1");
-
-                asm volatile("movss %0,%%xmm2" ::"m"(allone[0]):"xmm2");
-                asm volatile("shufps $0,%%xmm2,%%xmm2" :::"xmm2");
-                asm volatile("xorps %%xmm2,%%xmm3" :::"xmm2", "xmm3");
+    template <int DataLoads> static void measureMemoryOperand(std::false_type) {}
 
-                asm volatile("movss %0,%%xmm4" ::"m"(allone[0]):"xmm4");
-                asm volatile("shufps $0,%%xmm4,%%xmm4" :::"xmm4");
-                asm volatile("xorps %%xmm4,%%xmm5" :::"xmm4", "xmm5");
-
-                asm volatile("movss %0,%%xmm6" ::"m"(allone[0]):"xmm6");
-                asm volatile("shufps $0,%%xmm6,%%xmm6" :::"xmm6");
-                asm volatile("xorps %%xmm6,%%xmm7" :::"xmm6", "xmm7");
-            }
-            timer.Stop();
-        }
-        timer.Print();
+    template <int DataLoads> static void runAll()
+    {
+        measure<Generated, DataLoads>();
+        measure<Loaded, DataLoads>();
+        measure<Broadcast, DataLoads>();
+        measure<Immediate, DataLoads>();
+        measureMemoryOperand<DataLoads>(std::integral_constant<bool, Use::HasMemoryOperand>());
     }
+
+    static void run(const char *constantName)
     {
-        Benchmark timer("generated inversion", 4 * Factor, "Op");
-        while (timer.wantsMoreDataPoints()) {
-            timer.Start();
-            asm volatile("pxor %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("pxor %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("pxor %%xmm5,%%xmm5" :::"xmm5");
-            asm volatile("pxor %%xmm7,%%xmm7" :::"xmm7");
-            for (int i = 0; i < Factor; ++i) {
-                asm volatile("pcmpeqw %%xmm0,%%xmm0" :::"xmm0");
-                asm volatile("pxor %%xmm0,%%xmm1" :::"xmm0", "xmm1");
+        Benchmark::setColumnData("register", Reg::name());
+        Benchmark::setColumnData("constant", constantName);
+        Benchmark::setColumnData("live registers", "4");
+        Benchmark::setColumnData("data loads", "0");
+        runAll<0>();
+        Benchmark::setColumnData("data loads", "2");
+        runAll<2>();
+    }
+};/*}}}*/
 
-                asm volatile("pcmpeqw %%xmm2,%%xmm2" :::"xmm2");
-                asm volatile("pxor %%xmm2,%%xmm3" :::"xmm2", "xmm3");
+template <typename Reg> static void runRegister()
+{
+    Materialization<Reg, AllOnes, NoUse>::run("all ones");
+    Materialization<Reg, AbsMask, And>::run("abs mask");
+    Materialization<Reg, AllOnes, Xor>::run("inversion");
+    Materialization<Reg, SignMask, Xor>::run("sign mask");
+}
+#endif // __GNUC__ && __SSE2__
 
-                asm volatile("pcmpeqw %%xmm4,%%xmm4" :::"xmm4");
-                asm volatile("pxor %%xmm4,%%xmm5" :::"xmm4", "xmm5");
+/**
+ * The constants as the Vc API produces them. With 4 live accumulators the compiler can keep the
+ * constant in a register; with 16 it has to load or rematerialize it on every use.
+ */
+template <typename V> struct VcConstants/*{{{*/
+{
+    typedef typename V::EntryType T;
 
-                asm volatile("pcmpeqw %%xmm6,%%xmm6" :::"xmm6");
-                asm volatile("pxor %%xmm6,%%xmm7" :::"xmm6", "xmm7");
-            }
-            timer.Stop();
-        }
-        timer.Print();
-    }
+    template <int N, typename F> static void measure(const char *name, F &&f)
     {
-        Benchmark timer("loaded inversion", 4 * Factor, "Op");
+        Benchmark timer(name, N * Factor, "Op");
         while (timer.wantsMoreDataPoints()) {
+            V acc[N];
+            for (int k = 0; k < N; ++k) {
+                acc[k] = T(k + 1);
+            }
             timer.Start();
-            asm volatile("xorps %%xmm1,%%xmm1" :::"xmm1");
-            asm volatile("xorps %%xmm2,%%xmm2" :::"xmm2");
-            asm volatile("xorps %%xmm3,%%xmm3" :::"xmm3");
-            asm volatile("xorps %%xmm4,%%xmm4" :::"xmm4");
             for (int i = 0; i < Factor; ++i) {
-                asm volatile("xorps %0,%%xmm1" :: "m"(allone[0]) :"xmm1");
-                asm volatile("xorps %0,%%xmm2" :: "m"(allone[0]) :"xmm2");
-                asm volatile("xorps %0,%%xmm3" :: "m"(allone[0]) :"xmm3");
-                asm volatile("xorps %0,%%xmm4" :: "m"(allone[0]) :"xmm4");
+                for (int k = 0; k < N; ++k) {
+                    acc[k] = f(acc[k]);
+                    keepResultsDirty(acc[k]);
+                }
             }
             timer.Stop();
+            for (int k = 0; k < N; ++k) {
+                keepResults(acc[k]);
+            }
         }
         timer.Print();
     }
 
+    template <int N> static void runAll()
+    {
+        measure<N>("x + V::One()", [](V x) { return x + V::One(); });
+        measure<N>("x + V::IndexesFromZero()", [](V x) { return x + V::IndexesFromZero(); });
+        measure<N>("Vc::abs(x)", [](V x) { return Vc::abs(x); });
+        measure<N>("-x", [](V x) { return -x; });
+    }
+
+    static void run(const char *typeName)
+    {
+        Benchmark::setColumnData("register", typeName);
+        Benchmark::setColumnData("constant", "Vc API");
+        Benchmark::setColumnData("data loads", "0");
+        Benchmark::setColumnData("live registers", "4");
+        runAll<4>();
+        Benchmark::setColumnData("live registers", "16");
+        runAll<16>();
+    }
+};/*}}}*/
+
+int bmain()
+{
+    Benchmark::addColumn("register");
+    Benchmark::addColumn("constant");
+    Benchmark::addColumn("live registers");
+    Benchmark::addColumn("data loads");
+
+    for (int i = 0; i < DataSize; ++i) {
+        g_data[i] = float(i);
+    }
+
+#if defined __GNUC__ && defined __SSE2__
+    runRegister<Xmm>();
+#ifdef __AVX__
+    runRegister<Ymm>();
+#endif
+#endif
+    VcConstants<float_v>::run("float_v");
+    VcConstants<double_v>::run("double_v");
+
     return 0;
 }
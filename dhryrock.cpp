@@ -19,83 +19,67 @@
 
 #include <Vc/Vc>
 #include "benchmark.h"
+#include "rock.h"
 #include <limits>
 
 using namespace Vc;
 
-enum {
-    MemorySize = 1024 * 1024 * 64 // 64 MiB
-};
-
 void *blackHolePtr = 0;
 
-template<typename V>
-static void doBlah()
+struct DhryRock
 {
-    typedef typename V::EntryType T;
-    typedef typename V::IndexType I;
-    typedef typename V::Mask M;
+    static const char *name() { return "DhryRock"; }
 
-    const T two = 2;
-    const T divider = std::numeric_limits<T>::max() / 1500;
-    const T bound = 1000;
-
-    enum {
-        ArraySize = MemorySize / sizeof(V)
-    };
-    union {
-        V *v;
-        T *t;
-    } mem = { new V[ArraySize] };
-    for (int i = 0; i < ArraySize; ++i) {
-        mem.v[i] = V::Random();
-    }
-    V t = mem.v[0];
-    mem.v[0].setZero();
-    for (int i = 1; i < ArraySize; ++i) {
-        t = (t * mem.v[i] + t) / divider;
-        t(t >= bound || t < 0) = two;
-        mem.v[i] = t;
-        t(t == 0) += V(One);
-    }
-    M mask;
-    T data[1000];
-    for (I i(Vc::Zero); !(mask = i < 1000).isEmpty(); i += I::Size) {
-        I i2 = static_cast<I>(V(mem.t, i, mask));
-        V v(data, i2, mask);
-        v = v * two + t;
-        v.scatter(data, i2, mask);
+    template <typename V> static void init(V *mem, size_t arraySize)
+    {
+        for (size_t i = 0; i < arraySize; ++i) {
+            mem[i] = V::Random();
+        }
     }
+
+    template <typename V> static void compute(V *memV, size_t arraySize)
+    {
+        typedef typename V::EntryType T;
+        typedef typename V::IndexType I;
+        typedef typename V::Mask M;
+
+        const T two = 2;
+        const T divider = std::numeric_limits<T>::max() / 1500;
+        const T bound = 1000;
+
+        union {
+            V *v;
+            T *t;
+        } mem = { memV };
+        V t = mem.v[0];
+        mem.v[0].setZero();
+        for (size_t i = 1; i < arraySize; ++i) {
+            t = (t * mem.v[i] + t) / divider;
+            t(t >= bound || t < 0) = two;
+            mem.v[i] = t;
+            t(t == 0) += V(One);
+        }
+        M mask;
+        T data[1000];
+        for (I i(Vc::Zero); !(mask = i < 1000).isEmpty(); i += I::Size) {
+            I i2 = static_cast<I>(V(mem.t, i, mask));
+            V v(data, i2, mask);
+            v = v * two + t;
+            v.scatter(data, i2, mask);
+        }
 #ifdef __GNUC__
-    asm volatile(""::"m"(data[0]));
+        asm volatile(""::"m"(data[0]));
 #endif
-    blackHolePtr = mem.v;
-}
+        blackHolePtr = mem.v;
+    }
 
-template<typename V>
-static double opsFactor()
-{
-    enum {
-        ArraySize = MemorySize / sizeof(V)
-    };
-    return V::Size * (ArraySize * (5 + 10) + (1000 + V::Size - 1) / V::Size * 5);
-}
+    template <typename V> static double opsFactor(size_t arraySize)
+    {
+        return V::Size * (arraySize * (5 + 10) + (1000 + V::Size - 1) / V::Size * 5);
+    }
+};
 
 int bmain()
 {
-    Benchmark timer("DhryRock", opsFactor<int_v>() + opsFactor<uint_v>() + opsFactor<short_v>() + opsFactor<ushort_v>(), "Op");
-    while (timer.wantsMoreDataPoints()) {
-        timer.Start();
-        doBlah<int_v>();
-        delete[] static_cast<int_v *>(blackHolePtr);
-        doBlah<uint_v>();
-        delete[] static_cast<uint_v *>(blackHolePtr);
-        doBlah<short_v>();
-        delete[] static_cast<short_v *>(blackHolePtr);
-        doBlah<ushort_v>();
-        delete[] static_cast<ushort_v *>(blackHolePtr);
-        timer.Stop();
-    }
-    timer.Print();
-    return 0;
+    return Rock<DhryRock, int_v, uint_v, short_v, ushort_v>::run();
 }
@@ -21,6 +21,16 @@
 #include "benchmark.h"
 #include <cstdio>
 #include <cstdlib>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include "threads.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 // FIXME: is this standard?
 #ifdef __x86_64__
@@ -43,364 +53,732 @@ static float randomF(float min, float max)
 
 static float randomF12() { return randomF(1.f, 2.f); }
 
-int bmain()
+/*
+ * The number of independent accumulators needed to keep all FMA (or mul/add) units busy is the
+ * latency of the instruction times the number of ports that can execute it. The defaults fit
+ * Haswell/Broadwell (5 x 2); Skylake needs 4 x 2, Zen 5 x 2 (with half the width), older cores
+ * without FMA about 3-5 x 1 per mul and add port.
+ */
+#ifndef VC_BENCHMARK_FMA_LATENCY
+#define VC_BENCHMARK_FMA_LATENCY 5
+#endif
+#ifndef VC_BENCHMARK_FMA_PORTS
+#define VC_BENCHMARK_FMA_PORTS 2
+#endif
+enum {
+    Accumulators = VC_BENCHMARK_FMA_LATENCY * VC_BENCHMARK_FMA_PORTS
+};
+
+// register type abstraction for the intrinsics peak kernels/*{{{*/
+template <typename V> struct Intrinsics;
+#if VC_IMPL_SSE
+template <> struct Intrinsics<float_v>
 {
-    int blackHole = true;
-    // asm reference
-#ifdef __GNUC__
+#if VC_IMPL_AVX
+    typedef __m256 R;
+    static R set1(double x) { return _mm256_set1_ps(x); }
+    static int movemask(R x) { return _mm256_movemask_ps(x); }
+    static Vc_ALWAYS_INLINE R add(R a, R b) { return _mm256_add_ps(a, b); }
+#ifdef __FMA__
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm256_fmadd_ps(a, b, c); }
+#elif VC_IMPL_FMA4
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm256_macc_ps(a, b, c); }
+#else
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+#else
+    typedef __m128 R;
+    static R set1(double x) { return _mm_set1_ps(x); }
+    static int movemask(R x) { return _mm_movemask_ps(x); }
+    static Vc_ALWAYS_INLINE R add(R a, R b) { return _mm_add_ps(a, b); }
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+};
+template <> struct Intrinsics<double_v>
+{
+#if VC_IMPL_AVX
+    typedef __m256d R;
+    static R set1(double x) { return _mm256_set1_pd(x); }
+    static int movemask(R x) { return _mm256_movemask_pd(x); }
+    static Vc_ALWAYS_INLINE R add(R a, R b) { return _mm256_add_pd(a, b); }
+#ifdef __FMA__
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm256_fmadd_pd(a, b, c); }
+#elif VC_IMPL_FMA4
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm256_macc_pd(a, b, c); }
+#else
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+#endif
+#else
+    typedef __m128d R;
+    static R set1(double x) { return _mm_set1_pd(x); }
+    static int movemask(R x) { return _mm_movemask_pd(x); }
+    static Vc_ALWAYS_INLINE R add(R a, R b) { return _mm_add_pd(a, b); }
+    static Vc_ALWAYS_INLINE R madd(R a, R b, R c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+#endif
+};
+#endif/*}}}*/
+
+// multi-core driver/*{{{*/
+/**
+ * Counts the core clock cycles (user space) of the calling thread with a Linux perf event. Unlike
+ * the TSC these cycles follow the actual core frequency, including the license the kernel's
+ * AVX/FMA instructions select. Without perf events (other systems, or
+ * kernel.perf_event_paranoid > 2) isValid() returns false.
+ */
+class CoreCycles
+{
+public:
+    CoreCycles() : m_fd(-1)
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~CoreCycles()
+    {
+#ifdef __linux__
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+#endif
+    }
+    CoreCycles(const CoreCycles &) = delete;
+    CoreCycles &operator=(const CoreCycles &) = delete;
+
+    bool isValid() const { return m_fd >= 0; }
+    unsigned long long read() const
     {
-        Benchmark timer("asm reference", 2 * 8 * float_v::Size * Factor, "FLOP");
+        unsigned long long value = 0;
+#ifdef __linux__
+        if (m_fd < 0 || ::read(m_fd, &value, sizeof(value)) != sizeof(value)) {
+            return 0;
+        }
+#endif
+        return value;
+    }
+
+private:
+    int m_fd;
+};
+
+/**
+ * A ThreadedTimer::Handle that additionally measures the effective clock frequency of the core
+ * within the Start/Stop window of the kernel, i.e. without the time spent waiting for the other
+ * threads.
+ */
+class FrequencyHandle
+{
+public:
+    FrequencyHandle(ThreadedTimer &sync, int id) : m_handle(sync, id), m_cycles(0), m_seconds(0.) {}
+
+    void Start()
+    {
+        m_handle.Start();
+        m_cycles = m_counter.read();
+        m_start = std::chrono::steady_clock::now();
+    }
+    void Stop()
+    {
+        const auto end = std::chrono::steady_clock::now();
+        m_cycles = m_counter.read() - m_cycles;
+        m_seconds = std::chrono::duration<double>(end - m_start).count();
+        m_handle.Stop();
+    }
+
+    bool hasGHz() const { return m_counter.isValid() && m_seconds > 0.; }
+    double ghz() const { return m_cycles * 1e-9 / m_seconds; }
+
+private:
+    ThreadedTimer::Handle m_handle;
+    CoreCycles m_counter;
+    std::chrono::steady_clock::time_point m_start;
+    unsigned long long m_cycles;
+    double m_seconds;
+};
+
+/**
+ * Runs \p kernel on 1..N pinned cores at once (cf. threadCountsToTest) and reports the aggregate
+ * FLOP rate together with the mean effective clock frequency of the participating cores during
+ * the kernel ("n/a" without perf events). \p flopsPerThread is the number of FLOPs one call of
+ * \p kernel executes.
+ */
+template <typename Kernel>
+static void runScaling(const std::string &name, double flopsPerThread, Kernel &&kernel, int &blackHole)
+{
+    for (int threadCount : threadCountsToTest()) {
+        std::ostringstream str;
+        str << threadCount;
+        Benchmark::setColumnData("threads", str.str());
+        Benchmark timer(name, flopsPerThread * threadCount, "FLOP");
+        std::vector<int> blackHoles(threadCount, true);
+        std::vector<double> ghz(threadCount, 0.);
+        std::vector<int> ghzSamples(threadCount, 0);
         while (timer.wantsMoreDataPoints()) {
-#if VC_IMPL_FMA4
-            __m256 x[6] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
-            const __m256 y = _mm256_set1_ps(randomF12());
-            int i = Factor * 8 / 6;
-            asm volatile("":: "x"(x[0]), "x"(x[1]), "x"(x[2]), "x"(x[3]), "x"(x[4]), "x"(x[5]));
-            timer.Start();
-            ///////////////////////////////////////
-            asm(
-                    //".align 32\n\t"
-                    "0: "
-                    "vfmaddps %7,%0,%7,%0\n\t"
-                    "vfmaddps %7,%1,%7,%1\n\t"
-                    "vfmaddps %7,%2,%7,%2\n\t"
-                    "vfmaddps %7,%3,%7,%3\n\t"
-                    "vfmaddps %7,%4,%7,%4\n\t"
-                    "vfmaddps %7,%5,%7,%5\n\t"
-                    "dec      %6\n\t"
-                    "jne 0b"         "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+r"(i)
-                    : "x"(y)
-                       );
-            ///////////////////////////////////////
-            timer.Stop();
-
-            asm volatile("":: "x"(x[0]), "x"(x[1]), "x"(x[2]), "x"(x[3]), "x"(x[4]), "x"(x[5]));
+            ThreadedTimer sync(timer, threadCount);
+            runOnPinnedThreads(threadCount, [&](int t) {
+                FrequencyHandle handle(sync, t);
+                kernel(handle, blackHoles[t]);
+                if (handle.hasGHz()) {
+                    ghz[t] += handle.ghz();
+                    ++ghzSamples[t];
+                }
+            });
+        }
+        double sum = 0.;
+        int samples = 0;
+        for (int t = 0; t < threadCount; ++t) {
+            sum += ghz[t];
+            samples += ghzSamples[t];
+            blackHole &= blackHoles[t];
+        }
+        std::ostringstream freq;
+        if (samples > 0) {
+            freq << std::setprecision(3) << sum / samples;
+        } else {
+            freq << "n/a";
+        }
+        Benchmark::setColumnData("effective GHz", freq.str());
+        timer.Print();
+    }
+}
+/*}}}*/
 
+#ifdef __GNUC__
+template <typename Timer> static void asmReference(Timer &timer, int &blackHole)/*{{{*/
+{
+#if VC_IMPL_FMA4
+    __m256 x[6] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
+    const __m256 y = _mm256_set1_ps(randomF12());
+    int i = Factor * 8 / 6;
+    asm volatile("":: "x"(x[0]), "x"(x[1]), "x"(x[2]), "x"(x[3]), "x"(x[4]), "x"(x[5]));
+    timer.Start();
+    ///////////////////////////////////////
+    asm(
+            //".align 32\n\t"
+            "0: "
+            "vfmaddps %7,%0,%7,%0\n\t"
+            "vfmaddps %7,%1,%7,%1\n\t"
+            "vfmaddps %7,%2,%7,%2\n\t"
+            "vfmaddps %7,%3,%7,%3\n\t"
+            "vfmaddps %7,%4,%7,%4\n\t"
+            "vfmaddps %7,%5,%7,%5\n\t"
+            "dec      %6\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+r"(i)
+            : "x"(y)
+               );
+    ///////////////////////////////////////
+    timer.Stop();
+
+    asm volatile("":: "x"(x[0]), "x"(x[1]), "x"(x[2]), "x"(x[3]), "x"(x[4]), "x"(x[5]));
+
+#elif VC_IMPL_AVX && defined __FMA__ && defined VC_64BIT
+    // FMA3: ten accumulators cover latency 5 x 2 ports (Haswell); more need not fit into
+    // the register file together with y
+    __m256 x[10] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
+    const __m256 y = _mm256_set1_ps(randomF12());
+    int i = Factor * 8 / 10;
+    timer.Start();
+    ///////////////////////////////////////
+    asm(
+            ".align 16\n\t0: "
+            "vfmadd231ps %11,%11,%0\n\t"
+            "vfmadd231ps %11,%11,%1\n\t"
+            "vfmadd231ps %11,%11,%2\n\t"
+            "vfmadd231ps %11,%11,%3\n\t"
+            "vfmadd231ps %11,%11,%4\n\t"
+            "vfmadd231ps %11,%11,%5\n\t"
+            "vfmadd231ps %11,%11,%6\n\t"
+            "vfmadd231ps %11,%11,%7\n\t"
+            "vfmadd231ps %11,%11,%8\n\t"
+            "vfmadd231ps %11,%11,%9\n\t"
+            "dec         %10\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+x"(x[8]), "+x"(x[9]), "+r"(i)
+            : "x"(y)
+               );
+    ///////////////////////////////////////
+    timer.Stop();
+
+    const int k = _mm256_movemask_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x[0], x[1]), _mm256_add_ps(x[2], x[3])), _mm256_add_ps(_mm256_add_ps(x[4], x[5]), _mm256_add_ps(_mm256_add_ps(x[7], x[6]), _mm256_add_ps(x[8], x[9])))));
+    blackHole &= k;
 #elif VC_IMPL_AVX
-            __m256 x[8] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
-            const __m256 y = _mm256_set1_ps(randomF12());
+    __m256 x[8] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
+    const __m256 y = _mm256_set1_ps(randomF12());
 
-            timer.Start();
-            ///////////////////////////////////////
-            int i = Factor;
+    timer.Start();
+    ///////////////////////////////////////
+    int i = Factor;
 #ifdef VC_64BIT
-            __asm__(
-                    ".align 16\n\t0: "
-                    "vmulps  %9,%0,%0"   "\n\t"
-                    "vmulps  %9,%1,%1"   "\n\t"
-                    "vmulps  %9,%2,%2"   "\n\t"
-                    "vmulps  %9,%7,%7"   "\n\t"
-                    "vaddps  %9,%0,%0"   "\n\t"
-                    "vmulps  %9,%3,%3"   "\n\t"
-                    "vaddps  %9,%1,%1"   "\n\t"
-                    "vmulps  %9,%4,%4"   "\n\t"
-                    "vaddps  %9,%2,%2"   "\n\t"
-                    "vaddps  %9,%7,%7"   "\n\t"
-                    "vmulps  %9,%5,%5"   "\n\t"
-                    "vaddps  %9,%3,%3"   "\n\t"
-                    "vaddps  %9,%4,%4"   "\n\t"
-                    "vmulps  %9,%6,%6"   "\n\t"
-                    "vaddps  %9,%5,%5"   "\n\t"
-                    "vaddps  %9,%6,%6"   "\n\t"
-                    "dec     %8"      "\n\t"
-                    "jne 0b"          "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+r"(i)
-                    : "x"(y)
-                       );
+    __asm__(
+            ".align 16\n\t0: "
+            "vmulps  %9,%0,%0"   "\n\t"
+            "vmulps  %9,%1,%1"   "\n\t"
+            "vmulps  %9,%2,%2"   "\n\t"
+            "vmulps  %9,%7,%7"   "\n\t"
+            "vaddps  %9,%0,%0"   "\n\t"
+            "vmulps  %9,%3,%3"   "\n\t"
+            "vaddps  %9,%1,%1"   "\n\t"
+            "vmulps  %9,%4,%4"   "\n\t"
+            "vaddps  %9,%2,%2"   "\n\t"
+            "vaddps  %9,%7,%7"   "\n\t"
+            "vmulps  %9,%5,%5"   "\n\t"
+            "vaddps  %9,%3,%3"   "\n\t"
+            "vaddps  %9,%4,%4"   "\n\t"
+            "vmulps  %9,%6,%6"   "\n\t"
+            "vaddps  %9,%5,%5"   "\n\t"
+            "vaddps  %9,%6,%6"   "\n\t"
+            "dec     %8"      "\n\t"
+            "jne 0b"          "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+r"(i)
+            : "x"(y)
+               );
 #else
-            __asm__(
-                    ".align 16\n\t0: "
-                    "vmulps  %[y],%0,%0"   "\n\t"
-                    "vmulps  (%[x7]),%[y],%%ymm7"   "\n\t"
-                    "vmulps  %[y],%1,%1"   "\n\t"
-                    "vmulps  %[y],%2,%2"   "\n\t"
-                    "vaddps  %[y],%0,%0"   "\n\t"
-                    "vmulps  %[y],%3,%3"   "\n\t"
-                    "vaddps  %[y],%1,%1"   "\n\t"
-                    "vmulps  %[y],%4,%4"   "\n\t"
-                    "vaddps  %[y],%2,%2"   "\n\t"
-                    "vaddps  %[y],%%ymm7,%%ymm7"   "\n\t"
-                    "vmovaps     %%ymm7,(%[x7])"   "\n\t"
-                    "vmulps  %[y],%5,%5"   "\n\t"
-                    "vaddps  %[y],%3,%3"   "\n\t"
-                    "vaddps  %[y],%4,%4"   "\n\t"
-                    "vmulps  (%[x6]),%[y],%%ymm7"   "\n\t"
-                    "vaddps  %[y],%5,%5"   "\n\t"
-                    "vaddps  %[y],%%ymm7,%%ymm7"   "\n\t"
-                    "vmovaps     %%ymm7,(%[x6])"   "\n\t"
-                    "sub     $1,%[r]"      "\n\t"
-                    "jne 0b"         "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), [r]"+r"(i)
-                    : [x6]"r"(&x[6]), [x7]"r"(&x[7]), [y]"x"(y)
-                    : "xmm7");
+    __asm__(
+            ".align 16\n\t0: "
+            "vmulps  %[y],%0,%0"   "\n\t"
+            "vmulps  (%[x7]),%[y],%%ymm7"   "\n\t"
+            "vmulps  %[y],%1,%1"   "\n\t"
+            "vmulps  %[y],%2,%2"   "\n\t"
+            "vaddps  %[y],%0,%0"   "\n\t"
+            "vmulps  %[y],%3,%3"   "\n\t"
+            "vaddps  %[y],%1,%1"   "\n\t"
+            "vmulps  %[y],%4,%4"   "\n\t"
+            "vaddps  %[y],%2,%2"   "\n\t"
+            "vaddps  %[y],%%ymm7,%%ymm7"   "\n\t"
+            "vmovaps     %%ymm7,(%[x7])"   "\n\t"
+            "vmulps  %[y],%5,%5"   "\n\t"
+            "vaddps  %[y],%3,%3"   "\n\t"
+            "vaddps  %[y],%4,%4"   "\n\t"
+            "vmulps  (%[x6]),%[y],%%ymm7"   "\n\t"
+            "vaddps  %[y],%5,%5"   "\n\t"
+            "vaddps  %[y],%%ymm7,%%ymm7"   "\n\t"
+            "vmovaps     %%ymm7,(%[x6])"   "\n\t"
+            "sub     $1,%[r]"      "\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), [r]"+r"(i)
+            : [x6]"r"(&x[6]), [x7]"r"(&x[7]), [y]"x"(y)
+            : "xmm7");
 #endif
-            ///////////////////////////////////////
-            timer.Stop();
+    ///////////////////////////////////////
+    timer.Stop();
 
-            const int k = _mm256_movemask_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x[0], x[1]), _mm256_add_ps(x[2], x[3])), _mm256_add_ps(_mm256_add_ps(x[4], x[5]), _mm256_add_ps(x[7], x[6]))));
-            blackHole &= k;
+    const int k = _mm256_movemask_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x[0], x[1]), _mm256_add_ps(x[2], x[3])), _mm256_add_ps(_mm256_add_ps(x[4], x[5]), _mm256_add_ps(x[7], x[6]))));
+    blackHole &= k;
 #elif VC_IMPL_SSE
-            __m128 x[8] = { _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()) };
-            const __m128 y = _mm_set1_ps(randomF12());
+    __m128 x[8] = { _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()) };
+    const __m128 y = _mm_set1_ps(randomF12());
 
-            timer.Start();
-            ///////////////////////////////////////
-            int i = Factor;
+    timer.Start();
+    ///////////////////////////////////////
+    int i = Factor;
 #ifdef VC_64BIT
-            __asm__(
-                    ".align 16\n\t0: "
-                    "mulps  %9,%0"   "\n\t"
-                    "sub    $1,%8"   "\n\t"
-                    "mulps  %9,%1"   "\n\t"
-                    "mulps  %9,%2"   "\n\t"
-                    "mulps  %9,%7"   "\n\t"
-                    "addps  %9,%0"   "\n\t"
-                    "mulps  %9,%3"   "\n\t"
-                    "addps  %9,%1"   "\n\t"
-                    "mulps  %9,%4"   "\n\t"
-                    "addps  %9,%2"   "\n\t"
-                    "addps  %9,%7"   "\n\t"
-                    "mulps  %9,%5"   "\n\t"
-                    "addps  %9,%3"   "\n\t"
-                    "addps  %9,%4"   "\n\t"
-                    "mulps  %9,%6"   "\n\t"
-                    "addps  %9,%5"   "\n\t"
-                    "addps  %9,%6"   "\n\t"
-                    "jne 0b"         "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+r"(i)
-                    : "x"(y)
-                       );
+    __asm__(
+            ".align 16\n\t0: "
+            "mulps  %9,%0"   "\n\t"
+            "sub    $1,%8"   "\n\t"
+            "mulps  %9,%1"   "\n\t"
+            "mulps  %9,%2"   "\n\t"
+            "mulps  %9,%7"   "\n\t"
+            "addps  %9,%0"   "\n\t"
+            "mulps  %9,%3"   "\n\t"
+            "addps  %9,%1"   "\n\t"
+            "mulps  %9,%4"   "\n\t"
+            "addps  %9,%2"   "\n\t"
+            "addps  %9,%7"   "\n\t"
+            "mulps  %9,%5"   "\n\t"
+            "addps  %9,%3"   "\n\t"
+            "addps  %9,%4"   "\n\t"
+            "mulps  %9,%6"   "\n\t"
+            "addps  %9,%5"   "\n\t"
+            "addps  %9,%6"   "\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+r"(i)
+            : "x"(y)
+               );
 #else
-            __m128 tmp;
-            __asm__(
-                    ".align 16\n\t0: "
-                    "mulps  %10,%0"   "\n\t"
-                    "sub    $1,%9"   "\n\t"
-                    "mulps  %10,%1"   "\n\t"
-                    "mulps  %10,%2"   "\n\t"
-                    "movaps  %7,%8"   "\n\t"
-                    "mulps  %10,%8"   "\n\t"
-                    "addps  %10,%0"   "\n\t"
-                    "mulps  %10,%3"   "\n\t"
-                    "addps  %10,%1"   "\n\t"
-                    "mulps  %10,%4"   "\n\t"
-                    "addps  %10,%2"   "\n\t"
-                    "addps  %10,%8"   "\n\t"
-                    "movaps  %8,%7"   "\n\t"
-                    "mulps  %10,%5"   "\n\t"
-                    "addps  %10,%3"   "\n\t"
-                    "addps  %10,%4"   "\n\t"
-                    "movaps  %6,%8"   "\n\t"
-                    "mulps  %10,%8"   "\n\t"
-                    "addps  %10,%5"   "\n\t"
-                    "addps  %10,%8"   "\n\t"
-                    "movaps  %8,%6"   "\n\t"
-                    "jne 0b"         "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+m"(x[6]), "+m"(x[7]), "+x"(tmp), "+r"(i)
-                    : "x"(y)
-                       );
+    __m128 tmp;
+    __asm__(
+            ".align 16\n\t0: "
+            "mulps  %10,%0"   "\n\t"
+            "sub    $1,%9"   "\n\t"
+            "mulps  %10,%1"   "\n\t"
+            "mulps  %10,%2"   "\n\t"
+            "movaps  %7,%8"   "\n\t"
+            "mulps  %10,%8"   "\n\t"
+            "addps  %10,%0"   "\n\t"
+            "mulps  %10,%3"   "\n\t"
+            "addps  %10,%1"   "\n\t"
+            "mulps  %10,%4"   "\n\t"
+            "addps  %10,%2"   "\n\t"
+            "addps  %10,%8"   "\n\t"
+            "movaps  %8,%7"   "\n\t"
+            "mulps  %10,%5"   "\n\t"
+            "addps  %10,%3"   "\n\t"
+            "addps  %10,%4"   "\n\t"
+            "movaps  %6,%8"   "\n\t"
+            "mulps  %10,%8"   "\n\t"
+            "addps  %10,%5"   "\n\t"
+            "addps  %10,%8"   "\n\t"
+            "movaps  %8,%6"   "\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+m"(x[6]), "+m"(x[7]), "+x"(tmp), "+r"(i)
+            : "x"(y)
+               );
 #endif
-            ///////////////////////////////////////
-            timer.Stop();
+    ///////////////////////////////////////
+    timer.Stop();
 
-            const int k = _mm_movemask_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(x[0], x[1]), _mm_add_ps(x[2], x[3])), _mm_add_ps(_mm_add_ps(x[4], x[5]), _mm_add_ps(x[7], x[6]))));
-            blackHole &= k;
+    const int k = _mm_movemask_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(x[0], x[1]), _mm_add_ps(x[2], x[3])), _mm_add_ps(_mm_add_ps(x[4], x[5]), _mm_add_ps(x[7], x[6]))));
+    blackHole &= k;
 #else
-            float x[8] = { randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12() };
-            const float y = randomF12();
+    float x[8] = { randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12() };
+    const float y = randomF12();
 
-            timer.Start();
-            ///////////////////////////////////////
-            int i = Factor;
+    timer.Start();
+    ///////////////////////////////////////
+    int i = Factor;
 #ifdef VC_64BIT
-            __asm__(
-                    ".align 16\n\t0: "
-                    "mulss  %9,%0"   "\n\t"
-                    "sub    $1,%8"   "\n\t"
-                    "mulss  %9,%1"   "\n\t"
-                    "mulss  %9,%2"   "\n\t"
-                    "mulss  %9,%7"   "\n\t"
-                    "addss  %9,%0"   "\n\t"
-                    "mulss  %9,%3"   "\n\t"
-                    "addss  %9,%1"   "\n\t"
-                    "mulss  %9,%4"   "\n\t"
-                    "addss  %9,%2"   "\n\t"
-                    "addss  %9,%7"   "\n\t"
-                    "mulss  %9,%5"   "\n\t"
-                    "addss  %9,%3"   "\n\t"
-                    "addss  %9,%4"   "\n\t"
-                    "mulss  %9,%6"   "\n\t"
-                    "addss  %9,%5"   "\n\t"
-                    "addss  %9,%6"   "\n\t"
-                    "jne 0b"         "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+r"(i)
-                    : "x"(y)
-                    );
+    __asm__(
+            ".align 16\n\t0: "
+            "mulss  %9,%0"   "\n\t"
+            "sub    $1,%8"   "\n\t"
+            "mulss  %9,%1"   "\n\t"
+            "mulss  %9,%2"   "\n\t"
+            "mulss  %9,%7"   "\n\t"
+            "addss  %9,%0"   "\n\t"
+            "mulss  %9,%3"   "\n\t"
+            "addss  %9,%1"   "\n\t"
+            "mulss  %9,%4"   "\n\t"
+            "addss  %9,%2"   "\n\t"
+            "addss  %9,%7"   "\n\t"
+            "mulss  %9,%5"   "\n\t"
+            "addss  %9,%3"   "\n\t"
+            "addss  %9,%4"   "\n\t"
+            "mulss  %9,%6"   "\n\t"
+            "addss  %9,%5"   "\n\t"
+            "addss  %9,%6"   "\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+r"(i)
+            : "x"(y)
+            );
 #else
-            float tmp;
-            __asm__(
-                    ".align 16\n\t0: "
-                    "mulss  %10,%0"   "\n\t"
-                    "sub    $1,%9"   "\n\t"
-                    "mulss  %10,%1"   "\n\t"
-                    "mulss  %10,%2"   "\n\t"
-                    "movss  %7,%8"    "\n\t"
-                    "mulss  %10,%8"   "\n\t"
-                    "addss  %10,%0"   "\n\t"
-                    "mulss  %10,%3"   "\n\t"
-                    "addss  %10,%1"   "\n\t"
-                    "mulss  %10,%4"   "\n\t"
-                    "addss  %10,%2"   "\n\t"
-                    "addss  %10,%8"   "\n\t"
-                    "movss  %7,%8"    "\n\t"
-                    "mulss  %10,%5"   "\n\t"
-                    "addss  %10,%3"   "\n\t"
-                    "addss  %10,%4"   "\n\t"
-                    "movss  %6,%8"    "\n\t"
-                    "mulss  %10,%8"   "\n\t"
-                    "addss  %10,%5"   "\n\t"
-                    "addss  %10,%8"   "\n\t"
-                    "movss  %8,%6"    "\n\t"
-                    "jne 0b"         "\n\t"
-                    : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+m"(x[6]), "+m"(x[7]), "+x"(tmp), "+r"(i)
-                    : "x"(y)
-                    );
+    float tmp;
+    __asm__(
+            ".align 16\n\t0: "
+            "mulss  %10,%0"   "\n\t"
+            "sub    $1,%9"   "\n\t"
+            "mulss  %10,%1"   "\n\t"
+            "mulss  %10,%2"   "\n\t"
+            "movss  %7,%8"    "\n\t"
+            "mulss  %10,%8"   "\n\t"
+            "addss  %10,%0"   "\n\t"
+            "mulss  %10,%3"   "\n\t"
+            "addss  %10,%1"   "\n\t"
+            "mulss  %10,%4"   "\n\t"
+            "addss  %10,%2"   "\n\t"
+            "addss  %10,%8"   "\n\t"
+            "movss  %7,%8"    "\n\t"
+            "mulss  %10,%5"   "\n\t"
+            "addss  %10,%3"   "\n\t"
+            "addss  %10,%4"   "\n\t"
+            "movss  %6,%8"    "\n\t"
+            "mulss  %10,%8"   "\n\t"
+            "addss  %10,%5"   "\n\t"
+            "addss  %10,%8"   "\n\t"
+            "movss  %8,%6"    "\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+m"(x[6]), "+m"(x[7]), "+x"(tmp), "+r"(i)
+            : "x"(y)
+            );
 #endif
-            ///////////////////////////////////////
-            timer.Stop();
+    ///////////////////////////////////////
+    timer.Stop();
 
-            const int k = (x[0] < x[1]) && (x[2] < x[3]) && (x[4] < x[5]) && (x[7] < x[6]);
-            blackHole &= k;
+    const int k = (x[0] < x[1]) && (x[2] < x[3]) && (x[4] < x[5]) && (x[7] < x[6]);
+    blackHole &= k;
 #endif
-        }
-        timer.Print();
+}/*}}}*/
+#endif
+
+template <typename Timer> static void classReference(Timer &timer, int &blackHole)/*{{{*/
+{
+    const float_v alpha(-randomF(.1f, .2f));
+    const float_v y = randomF12();
+    float_v x[8] = { randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12() };
+
+    // force the x vectors to registers, otherwise GCC decides to work on the stack and
+    // lose half of the performance
+    //forceToRegisters(x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7]);
+
+    timer.Start();
+    ///////////////////////////////////////
+
+    for (int i = 0; i < Factor; ++i) {
+            x[0] = y * x[0] + y;
+            x[1] = y * x[1] + y;
+            x[2] = y * x[2] + y;
+            x[3] = y * x[3] + y;
+            x[4] = y * x[4] + y;
+            x[5] = y * x[5] + y;
+            x[6] = y * x[6] + y;
+            x[7] = y * x[7] + y;
     }
+
+    ///////////////////////////////////////
+    timer.Stop();
+
+    const int k = all_of((x[0] < x[1]) && (x[2] < x[3]) && (x[4] < x[5]) && (x[7] < x[6]));
+    blackHole &= k;
+}/*}}}*/
+
+template <typename Timer> static void intrinsicsReference(Timer &timer, int &blackHole)/*{{{*/
+{
+#if VC_IMPL_AVX
+    __m256 x[8] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
+    const __m256 y = _mm256_set1_ps(randomF12());
+
+    timer.Start();
+    ///////////////////////////////////////
+
+    for (int i = 0; i < Factor; ++i) {
+#if VC_IMPL_FMA4
+            x[0] = _mm256_macc_ps(y, x[0], y);
+            x[1] = _mm256_macc_ps(y, x[1], y);
+            x[2] = _mm256_macc_ps(y, x[2], y);
+            x[3] = _mm256_macc_ps(y, x[3], y);
+            x[4] = _mm256_macc_ps(y, x[4], y);
+            x[5] = _mm256_macc_ps(y, x[5], y);
+            x[6] = _mm256_macc_ps(y, x[6], y);
+            x[7] = _mm256_macc_ps(y, x[7], y);
+#elif defined __FMA__
+            x[0] = _mm256_fmadd_ps(y, x[0], y);
+            x[1] = _mm256_fmadd_ps(y, x[1], y);
+            x[2] = _mm256_fmadd_ps(y, x[2], y);
+            x[3] = _mm256_fmadd_ps(y, x[3], y);
+            x[4] = _mm256_fmadd_ps(y, x[4], y);
+            x[5] = _mm256_fmadd_ps(y, x[5], y);
+            x[6] = _mm256_fmadd_ps(y, x[6], y);
+            x[7] = _mm256_fmadd_ps(y, x[7], y);
+#else
+            x[0] = _mm256_add_ps(_mm256_mul_ps(y, x[0]), y);
+            x[1] = _mm256_add_ps(_mm256_mul_ps(y, x[1]), y);
+            x[2] = _mm256_add_ps(_mm256_mul_ps(y, x[2]), y);
+            x[3] = _mm256_add_ps(_mm256_mul_ps(y, x[3]), y);
+            x[4] = _mm256_add_ps(_mm256_mul_ps(y, x[4]), y);
+            x[5] = _mm256_add_ps(_mm256_mul_ps(y, x[5]), y);
+            x[6] = _mm256_add_ps(_mm256_mul_ps(y, x[6]), y);
+            x[7] = _mm256_add_ps(_mm256_mul_ps(y, x[7]), y);
 #endif
+    }
 
-    {
-        Benchmark timer("class", 2 * 8 * float_v::Size * Factor, "FLOP");
-        while (timer.wantsMoreDataPoints()) {
-            const float_v alpha(-randomF(.1f, .2f));
-            const float_v y = randomF12();
-            float_v x[8] = { randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12() };
-
-            // force the x vectors to registers, otherwise GCC decides to work on the stack and
-            // lose half of the performance
-            //forceToRegisters(x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7]);
-
-            timer.Start();
-            ///////////////////////////////////////
-
-            for (int i = 0; i < Factor; ++i) {
-                    x[0] = y * x[0] + y;
-                    x[1] = y * x[1] + y;
-                    x[2] = y * x[2] + y;
-                    x[3] = y * x[3] + y;
-                    x[4] = y * x[4] + y;
-                    x[5] = y * x[5] + y;
-                    x[6] = y * x[6] + y;
-                    x[7] = y * x[7] + y;
-            }
+    ///////////////////////////////////////
+    timer.Stop();
 
-            ///////////////////////////////////////
-            timer.Stop();
+    const int k = _mm256_movemask_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x[0], x[1]), _mm256_add_ps(x[2], x[3])), _mm256_add_ps(_mm256_add_ps(x[4], x[5]), _mm256_add_ps(x[7], x[6]))));
+    blackHole &= k;
+#elif VC_IMPL_SSE
+    __m128 x[8] = { _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()) };
+    const __m128 y = _mm_set1_ps(randomF12());
+
+    timer.Start();
+    ///////////////////////////////////////
+
+    for (int i = 0; i < Factor; ++i) {
+            x[0] = _mm_add_ps(_mm_mul_ps(y, x[0]), y);
+            x[1] = _mm_add_ps(_mm_mul_ps(y, x[1]), y);
+            x[2] = _mm_add_ps(_mm_mul_ps(y, x[2]), y);
+            x[3] = _mm_add_ps(_mm_mul_ps(y, x[3]), y);
+            x[4] = _mm_add_ps(_mm_mul_ps(y, x[4]), y);
+            x[5] = _mm_add_ps(_mm_mul_ps(y, x[5]), y);
+            x[6] = _mm_add_ps(_mm_mul_ps(y, x[6]), y);
+            x[7] = _mm_add_ps(_mm_mul_ps(y, x[7]), y);
+    }
 
-            const int k = all_of((x[0] < x[1]) && (x[2] < x[3]) && (x[4] < x[5]) && (x[7] < x[6]));
-            blackHole &= k;
-        }
-        timer.Print();
+    ///////////////////////////////////////
+    timer.Stop();
+
+    const int k = _mm_movemask_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(x[0], x[1]), _mm_add_ps(x[2], x[3])), _mm_add_ps(_mm_add_ps(x[4], x[5]), _mm_add_ps(x[7], x[6]))));
+    blackHole &= k;
+#else
+    float x[8] = { randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12() };
+    const float y = randomF12();
+
+    timer.Start();
+    ///////////////////////////////////////
+
+    for (int i = 0; i < Factor; ++i) {
+            x[0] = y * x[0] + y;
+            x[1] = y * x[1] + y;
+            x[2] = y * x[2] + y;
+            x[3] = y * x[3] + y;
+            x[4] = y * x[4] + y;
+            x[5] = y * x[5] + y;
+            x[6] = y * x[6] + y;
+            x[7] = y * x[7] + y;
     }
 
+    ///////////////////////////////////////
+    timer.Stop();
 
-    // intrinsics reference
+    const int k = (x[0] < x[1]) && (x[2] < x[3]) && (x[4] < x[5]) && (x[7] < x[6]);
+    blackHole &= k;
+#endif
+}/*}}}*/
+
+#if defined __GNUC__ && VC_IMPL_AVX && defined __FMA__ && defined VC_64BIT
+template <typename Timer> static void asmReferenceDouble(Timer &timer, int &blackHole)/*{{{*/
+{
+    __m256d x[10] = { _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()), _mm256_set1_pd(randomF12()) };
+    const __m256d y = _mm256_set1_pd(randomF12());
+    int i = Factor * 8 / 10;
+    timer.Start();
+    ///////////////////////////////////////
+    asm(
+            ".align 16\n\t0: "
+            "vfmadd231pd %11,%11,%0\n\t"
+            "vfmadd231pd %11,%11,%1\n\t"
+            "vfmadd231pd %11,%11,%2\n\t"
+            "vfmadd231pd %11,%11,%3\n\t"
+            "vfmadd231pd %11,%11,%4\n\t"
+            "vfmadd231pd %11,%11,%5\n\t"
+            "vfmadd231pd %11,%11,%6\n\t"
+            "vfmadd231pd %11,%11,%7\n\t"
+            "vfmadd231pd %11,%11,%8\n\t"
+            "vfmadd231pd %11,%11,%9\n\t"
+            "dec         %10\n\t"
+            "jne 0b"         "\n\t"
+            : "+x"(x[0]), "+x"(x[1]), "+x"(x[2]), "+x"(x[3]), "+x"(x[4]), "+x"(x[5]), "+x"(x[6]), "+x"(x[7]), "+x"(x[8]), "+x"(x[9]), "+r"(i)
+            : "x"(y)
+               );
+    ///////////////////////////////////////
+    timer.Stop();
+
+    const int k = _mm256_movemask_pd(_mm256_add_pd(_mm256_add_pd(_mm256_add_pd(x[0], x[1]), _mm256_add_pd(x[2], x[3])), _mm256_add_pd(_mm256_add_pd(x[4], x[5]), _mm256_add_pd(_mm256_add_pd(x[7], x[6]), _mm256_add_pd(x[8], x[9])))));
+    blackHole &= k;
+}/*}}}*/
+#endif
+
+/**
+ * Peak FLOP kernels with Accumulators independent chains of y * x + y, using the Vc class and the
+ * raw intrinsics. The class kernel calls Vc::fma only if the target has FMA instructions:
+ * without them Vc emulates a single-rounding fma, which is much slower than a mul and an add.
+ */
+template <typename V> struct Peak/*{{{*/
+{
+    typedef typename V::EntryType T;
+    enum {
+        Iterations = Factor * 8 / Accumulators
+    };
+
+    template <typename Timer> static void classKernel(Timer &timer, int &blackHole)
     {
-        Benchmark timer("intrinsics reference", 2 * 8 * float_v::Size * Factor, "FLOP");
-        while (timer.wantsMoreDataPoints()) {
-#if VC_IMPL_AVX
-            __m256 x[8] = { _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()), _mm256_set1_ps(randomF12()) };
-            const __m256 y = _mm256_set1_ps(randomF12());
+        const V y = T(randomF12());
+        V x[Accumulators];
+        for (int k = 0; k < Accumulators; ++k) {
+            x[k] = T(randomF12());
+        }
 
-            timer.Start();
-            ///////////////////////////////////////
+        timer.Start();
+        ///////////////////////////////////////
 
-            for (int i = 0; i < Factor; ++i) {
-#if VC_IMPL_FMA4
-                    x[0] = _mm256_macc_ps(y, x[0], y);
-                    x[1] = _mm256_macc_ps(y, x[1], y);
-                    x[2] = _mm256_macc_ps(y, x[2], y);
-                    x[3] = _mm256_macc_ps(y, x[3], y);
-                    x[4] = _mm256_macc_ps(y, x[4], y);
-                    x[5] = _mm256_macc_ps(y, x[5], y);
-                    x[6] = _mm256_macc_ps(y, x[6], y);
-                    x[7] = _mm256_macc_ps(y, x[7], y);
+        for (int i = 0; i < Iterations; ++i) {
+            for (int k = 0; k < Accumulators; ++k) {
+#if defined __FMA__ || defined __FMA4__
+                x[k] = Vc::fma(y, x[k], y);
 #else
-                    x[0] = _mm256_add_ps(_mm256_mul_ps(y, x[0]), y);
-                    x[1] = _mm256_add_ps(_mm256_mul_ps(y, x[1]), y);
-                    x[2] = _mm256_add_ps(_mm256_mul_ps(y, x[2]), y);
-                    x[3] = _mm256_add_ps(_mm256_mul_ps(y, x[3]), y);
-                    x[4] = _mm256_add_ps(_mm256_mul_ps(y, x[4]), y);
-                    x[5] = _mm256_add_ps(_mm256_mul_ps(y, x[5]), y);
-                    x[6] = _mm256_add_ps(_mm256_mul_ps(y, x[6]), y);
-                    x[7] = _mm256_add_ps(_mm256_mul_ps(y, x[7]), y);
+                x[k] = y * x[k] + y;
 #endif
             }
+        }
 
-            ///////////////////////////////////////
-            timer.Stop();
+        ///////////////////////////////////////
+        timer.Stop();
 
-            const int k = _mm256_movemask_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x[0], x[1]), _mm256_add_ps(x[2], x[3])), _mm256_add_ps(_mm256_add_ps(x[4], x[5]), _mm256_add_ps(x[7], x[6]))));
-            blackHole &= k;
-#elif VC_IMPL_SSE
-            __m128 x[8] = { _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()), _mm_set1_ps(randomF12()) };
-            const __m128 y = _mm_set1_ps(randomF12());
-
-            timer.Start();
-            ///////////////////////////////////////
-
-            for (int i = 0; i < Factor; ++i) {
-                    x[0] = _mm_add_ps(_mm_mul_ps(y, x[0]), y);
-                    x[1] = _mm_add_ps(_mm_mul_ps(y, x[1]), y);
-                    x[2] = _mm_add_ps(_mm_mul_ps(y, x[2]), y);
-                    x[3] = _mm_add_ps(_mm_mul_ps(y, x[3]), y);
-                    x[4] = _mm_add_ps(_mm_mul_ps(y, x[4]), y);
-                    x[5] = _mm_add_ps(_mm_mul_ps(y, x[5]), y);
-                    x[6] = _mm_add_ps(_mm_mul_ps(y, x[6]), y);
-                    x[7] = _mm_add_ps(_mm_mul_ps(y, x[7]), y);
-            }
+        V sum = x[0];
+        for (int k = 1; k < Accumulators; ++k) {
+            sum += x[k];
+        }
+        blackHole &= all_of(sum < y);
+    }
 
-            ///////////////////////////////////////
-            timer.Stop();
+#if VC_IMPL_SSE
+    template <typename Timer> static void intrinsicsKernel(Timer &timer, int &blackHole)
+    {
+        typedef Intrinsics<V> I;
+        typedef typename I::R R;
+        const R y = I::set1(randomF12());
+        R x[Accumulators];
+        for (int k = 0; k < Accumulators; ++k) {
+            x[k] = I::set1(randomF12());
+        }
 
-            const int k = _mm_movemask_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(x[0], x[1]), _mm_add_ps(x[2], x[3])), _mm_add_ps(_mm_add_ps(x[4], x[5]), _mm_add_ps(x[7], x[6]))));
-            blackHole &= k;
-#else
-            float x[8] = { randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12(), randomF12() };
-            const float y = randomF12();
-
-            timer.Start();
-            ///////////////////////////////////////
-
-            for (int i = 0; i < Factor; ++i) {
-                    x[0] = y * x[0] + y;
-                    x[1] = y * x[1] + y;
-                    x[2] = y * x[2] + y;
-                    x[3] = y * x[3] + y;
-                    x[4] = y * x[4] + y;
-                    x[5] = y * x[5] + y;
-                    x[6] = y * x[6] + y;
-                    x[7] = y * x[7] + y;
+        timer.Start();
+        ///////////////////////////////////////
+
+        for (int i = 0; i < Iterations; ++i) {
+            for (int k = 0; k < Accumulators; ++k) {
+                x[k] = I::madd(y, x[k], y);
             }
+        }
 
-            ///////////////////////////////////////
-            timer.Stop();
+        ///////////////////////////////////////
+        timer.Stop();
 
-            const int k = (x[0] < x[1]) && (x[2] < x[3]) && (x[4] < x[5]) && (x[7] < x[6]);
-            blackHole &= k;
-#endif
+        R sum = x[0];
+        for (int k = 1; k < Accumulators; ++k) {
+            sum = I::add(sum, x[k]);
         }
-        timer.Print();
+        blackHole &= I::movemask(sum);
     }
+#endif
+
+    static void run(int &blackHole)
+    {
+        const double flops = 2. * Accumulators * V::Size * Iterations;
+        std::ostringstream name;
+        name << "class (" << Accumulators << " accumulators)";
+        runScaling(name.str(), flops,
+                   [](FrequencyHandle &timer, int &k) { classKernel(timer, k); }, blackHole);
+#if VC_IMPL_SSE
+        name.str(std::string());
+        name << "intrinsics reference (" << Accumulators << " accumulators)";
+        runScaling(name.str(), flops,
+                   [](FrequencyHandle &timer, int &k) { intrinsicsKernel(timer, k); }, blackHole);
+#endif
+    }
+};/*}}}*/
+
+int bmain()
+{
+    int blackHole = true;
+    Benchmark::addColumn("datatype");
+    Benchmark::addColumn("threads");
+    Benchmark::addColumn("effective GHz");
+    Benchmark::setColumnData("datatype", "float_v");
+
+    const double flops = 2 * 8 * float_v::Size * Factor;
+#ifdef __GNUC__
+    runScaling("asm reference", flops, [](FrequencyHandle &timer, int &k) { asmReference(timer, k); }, blackHole);
+#endif
+    runScaling("class", flops, [](FrequencyHandle &timer, int &k) { classReference(timer, k); }, blackHole);
+    runScaling("intrinsics reference", flops, [](FrequencyHandle &timer, int &k) { intrinsicsReference(timer, k); }, blackHole);
+    Peak<float_v>::run(blackHole);
+
+    Benchmark::setColumnData("datatype", "double_v");
+#if defined __GNUC__ && VC_IMPL_AVX && defined __FMA__ && defined VC_64BIT
+    runScaling("asm reference", 2 * 8 * double_v::Size * Factor,
+               [](FrequencyHandle &timer, int &k) { asmReferenceDouble(timer, k); }, blackHole);
+#endif
+    Peak<double_v>::run(blackHole);
+
     if (blackHole != 0) {
         std::cout << std::endl;
     }
@@ -0,0 +1,78 @@
+/*  This file is part of the Vc library.
+
+    Copyright (C) 2016 Matthias Kretz <kretz@kde.org>
+
+    Vc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    Vc is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Vc.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef VC_BENCHMARK_INTERLEAVEDCHUNKS_H
+#define VC_BENCHMARK_INTERLEAVEDCHUNKS_H
+
+#include <Vc/Vc>
+#include <utility>
+
+/*
+ * The (a, b, c, ...) = wrapper[i] and wrapper[i] = (a, b, c, ...) expressions for any member
+ * count, generated with Vc::tie over an index sequence. One wrapper access (de)interleaves at
+ * most MaxChunk vectors, so larger records are processed in chunks: the wrapper of a chunk starts
+ * at the first member of the chunk and keeps the stride of the whole record.
+ */
+enum {
+    MaxChunk = 8
+};
+
+template <typename V, std::size_t Offset, typename S, typename I, std::size_t... K>
+static Vc_ALWAYS_INLINE void deinterleaveChunk(S *data, const I &i, V *x,
+                                               std::index_sequence<K...>)
+{
+    Vc::InterleavedMemoryWrapper<S, V> wrapper(
+        reinterpret_cast<S *>(reinterpret_cast<typename V::EntryType *>(data) + Offset));
+    Vc::tie(x[Offset + K]...) = wrapper[i];
+}
+
+template <typename V, std::size_t Offset, typename S, typename I, std::size_t... K>
+static Vc_ALWAYS_INLINE void interleaveChunk(S *data, const I &i, V *x,
+                                             std::index_sequence<K...>)
+{
+    Vc::InterleavedMemoryWrapper<S, V> wrapper(
+        reinterpret_cast<S *>(reinterpret_cast<typename V::EntryType *>(data) + Offset));
+    wrapper[i] = Vc::tie(x[Offset + K]...);
+}
+
+template <typename V, int Offset, int Count> struct Chunks
+{
+    enum { Length = Count - Offset < MaxChunk ? Count - Offset : MaxChunk };
+    template <typename S, typename I>
+    static Vc_ALWAYS_INLINE void deinterleave(S *data, const I &i, V *x)
+    {
+        deinterleaveChunk<V, Offset>(data, i, x, std::make_index_sequence<Length>());
+        Chunks<V, Offset + Length, Count>::deinterleave(data, i, x);
+    }
+    template <typename S, typename I>
+    static Vc_ALWAYS_INLINE void interleave(S *data, const I &i, V *x)
+    {
+        interleaveChunk<V, Offset>(data, i, x, std::make_index_sequence<Length>());
+        Chunks<V, Offset + Length, Count>::interleave(data, i, x);
+    }
+};
+template <typename V, int Count> struct Chunks<V, Count, Count>
+{
+    template <typename S, typename I>
+    static Vc_ALWAYS_INLINE void deinterleave(S *, const I &, V *) {}
+    template <typename S, typename I>
+    static Vc_ALWAYS_INLINE void interleave(S *, const I &, V *) {}
+};
+
+#endif // VC_BENCHMARK_INTERLEAVEDCHUNKS_H
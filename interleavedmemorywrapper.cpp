@@ -17,11 +17,14 @@
 }}}*/
 
 #include "benchmark.h"
+#include "interleavedchunks.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
 #include <vector>
 #include <Vc/cpuid.h>
 
 using Vc::float_v;
-using sfloat_v = Vc::SimdArray<float, short_v::size()>;
 using Vc::double_v;
 using Vc::int_v;
 using Vc::short_v;
@@ -29,49 +32,76 @@ using Vc::short_v;
 namespace std
 {
     int_v sqrt(int_v::AsArg x) {
-        return static_cast<int_v>(sqrt(static_cast<float_v>(x)));
+        return Vc::simd_cast<int_v>(sqrt(Vc::simd_cast<float_v>(x)));
     }
     short_v sqrt(short_v::AsArg x) {
-        return static_cast<short_v>(sqrt(static_cast<sfloat_v>(x)));
+        typedef Vc::SimdArray<float, short_v::Size> F;
+        return Vc::simd_cast<short_v>(sqrt(Vc::simd_cast<F>(x)));
     }
 } // namespace std
 
-template<int Count, typename V, typename T, typename I> struct NormalizeHelper;
-template<typename V, typename T, typename I> struct NormalizeHelper<2, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b;                   (a, b                  ) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b                                    ); wrapper[i] = (a*factor, b*factor                                                            ); } };
-template<typename V, typename T, typename I> struct NormalizeHelper<3, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b, c;                (a, b, c               ) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b + c*c                              ); wrapper[i] = (a*factor, b*factor, c*factor                                                  ); } };
-template<typename V, typename T, typename I> struct NormalizeHelper<4, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b, c, d;             (a, b, c, d            ) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b + c*c + d*d                        ); wrapper[i] = (a*factor, b*factor, c*factor, d*factor                                        ); } };
-template<typename V, typename T, typename I> struct NormalizeHelper<5, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b, c, d, e;          (a, b, c, d, e         ) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b + c*c + d*d + e*e                  ); wrapper[i] = (a*factor, b*factor, c*factor, d*factor, e*factor                              ); } };
-template<typename V, typename T, typename I> struct NormalizeHelper<6, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b, c, d, e, f;       (a, b, c, d, e, f      ) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b + c*c + d*d + e*e + f*f            ); wrapper[i] = (a*factor, b*factor, c*factor, d*factor, e*factor, f*factor                    ); } };
-template<typename V, typename T, typename I> struct NormalizeHelper<7, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b, c, d, e, f, g;    (a, b, c, d, e, f, g   ) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b + c*c + d*d + e*e + f*f + g*g      ); wrapper[i] = (a*factor, b*factor, c*factor, d*factor, e*factor, f*factor, g*factor          ); } };
-template<typename V, typename T, typename I> struct NormalizeHelper<8, V, T, I> { static void impl(T &wrapper, const I &i) { V a, b, c, d, e, f, g, h; (a, b, c, d, e, f, g, h) = wrapper[i]; const V factor = V::One() / std::sqrt(a*a + b*b + c*c + d*d + e*e + f*f + g*g + h*h); wrapper[i] = (a*factor, b*factor, c*factor, d*factor, e*factor, f*factor, g*factor, h*factor); } };
-template<int Count, typename V, typename T, typename I> static void normalize(T &wrapper, const I &i) { NormalizeHelper<Count, V, T, I>::impl(wrapper, i); }
-
-template<int Count, typename V, typename T, typename I> struct DeinterleaveHelper;
-template<typename V, typename T, typename I> struct DeinterleaveHelper<2, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b;                   (a, b) = wrapper[i];                   keepResults(a, b); } };
-template<typename V, typename T, typename I> struct DeinterleaveHelper<3, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b, c;                (a, b, c) = wrapper[i];                keepResults(a, b, c); } };
-template<typename V, typename T, typename I> struct DeinterleaveHelper<4, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b, c, d;             (a, b, c, d) = wrapper[i];             keepResults(a, b, c, d); } };
-template<typename V, typename T, typename I> struct DeinterleaveHelper<5, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b, c, d, e;          (a, b, c, d, e) = wrapper[i];          keepResults(a, b, c, d, e); } };
-template<typename V, typename T, typename I> struct DeinterleaveHelper<6, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b, c, d, e, f;       (a, b, c, d, e, f) = wrapper[i];       keepResults(a, b, c, d, e, f); } };
-template<typename V, typename T, typename I> struct DeinterleaveHelper<7, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b, c, d, e, f, g;    (a, b, c, d, e, f, g) = wrapper[i];    keepResults(a, b, c, d, e, f, g); } };
-template<typename V, typename T, typename I> struct DeinterleaveHelper<8, V, T, I> { static void impl(const T &wrapper, const I &i) { V a, b, c, d, e, f, g, h; (a, b, c, d, e, f, g, h) = wrapper[i]; keepResults(a, b, c, d, e, f, g, h); } };
-template<int Count, typename V, typename T, typename I> static void deinterleave(const T &wrapper, const I &i) { DeinterleaveHelper<Count, V, T, I>::impl(wrapper, i); }
-
-template<typename V> struct SomeData { static V x[8]; };
-template<> float_v SomeData<float_v>::x[8] = { float_v::One() };
-template<> sfloat_v SomeData<sfloat_v>::x[8] = { sfloat_v::One() };
-template<> double_v SomeData<double_v>::x[8] = { double_v::One() };
-template<> int_v SomeData<int_v>::x[8] = { int_v::One() };
-template<> short_v SomeData<short_v>::x[8] = { short_v::One() };
-
-template<int Count, typename V, typename T, typename I> struct InterleaveHelper;
-template<typename V, typename T, typename I> struct InterleaveHelper<2, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1]); } };
-template<typename V, typename T, typename I> struct InterleaveHelper<3, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1], SomeData<V>::x[2]); } };
-template<typename V, typename T, typename I> struct InterleaveHelper<4, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1], SomeData<V>::x[2], SomeData<V>::x[3]); } };
-template<typename V, typename T, typename I> struct InterleaveHelper<5, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1], SomeData<V>::x[2], SomeData<V>::x[3], SomeData<V>::x[4]); } };
-template<typename V, typename T, typename I> struct InterleaveHelper<6, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1], SomeData<V>::x[2], SomeData<V>::x[3], SomeData<V>::x[4], SomeData<V>::x[5]); } };
-template<typename V, typename T, typename I> struct InterleaveHelper<7, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1], SomeData<V>::x[2], SomeData<V>::x[3], SomeData<V>::x[4], SomeData<V>::x[5], SomeData<V>::x[6]); } };
-template<typename V, typename T, typename I> struct InterleaveHelper<8, V, T, I> { static void impl(T &wrapper, const I &i) { wrapper[i] = (SomeData<V>::x[0], SomeData<V>::x[1], SomeData<V>::x[2], SomeData<V>::x[3], SomeData<V>::x[4], SomeData<V>::x[5], SomeData<V>::x[6], SomeData<V>::x[7]); } };
-template<int Count, typename V, typename T, typename I> static void interleave(T &wrapper, const I &i) { InterleaveHelper<Count, V, T, I>::impl(wrapper, i); }
+enum {
+    MaxCount = 32,
+    // length of the random index streams
+    IndexCount = 1 << 18
+};
+
+template<typename V> struct SomeData { static V x[MaxCount]; };
+template<> float_v SomeData<float_v>::x[MaxCount] = { float_v::One() };
+template<> double_v SomeData<double_v>::x[MaxCount] = { double_v::One() };
+template<> int_v SomeData<int_v>::x[MaxCount] = { int_v::One() };
+template<> short_v SomeData<short_v>::x[MaxCount] = { short_v::One() };
+
+template<int Count, typename V, typename S, typename I> static void deinterleave(S *data, const I &i)
+{
+    V x[Count];
+    Chunks<V, 0, Count>::deinterleave(data, i, x);
+    for (int k = 0; k < Count; ++k) {
+        keepResults(x[k]);
+    }
+}
+
+template<int Count, typename V, typename S, typename I> static void interleave(S *data, const I &i)
+{
+    Chunks<V, 0, Count>::interleave(data, i, SomeData<V>::x);
+}
+
+template<int Count, typename V, typename S, typename I> static void normalize(S *data, const I &i)
+{
+    V x[Count];
+    Chunks<V, 0, Count>::deinterleave(data, i, x);
+    V sum = x[0] * x[0];
+    for (int k = 1; k < Count; ++k) {
+        sum += x[k] * x[k];
+    }
+    const V factor = V::One() / std::sqrt(sum);
+    for (int k = 0; k < Count; ++k) {
+        x[k] *= factor;
+    }
+    Chunks<V, 0, Count>::interleave(data, i, x);
+}
+
+/**
+ * Returns \p count random record indexes in [0, \p records), optionally sorted, as produced by
+ * the index lists that select records for processing.
+ */
+template <typename IT> static std::vector<IT> randomIndexes(size_t count, size_t records, bool sorted)
+{
+    std::vector<IT> r(count);
+    for (size_t j = 0; j < count; ++j) {
+        r[j] = static_cast<IT>(std::rand() % records);
+    }
+    if (sorted) {
+        std::sort(r.begin(), r.end());
+    }
+    return r;
+}
+
+/// The working set for the random index streams: larger than the last level cache.
+static size_t largeArrayBytes()
+{
+    return Vc::CpuId::L3Data() > 0 ? size_t(Vc::CpuId::L3Data()) * 4 : size_t(Vc::CpuId::L2Data()) * 4;
+}
 
 template<typename V> class Runner
 {
@@ -104,14 +134,12 @@ template<typename V> class Runner
         mlock(&data[0], 1024 * sizeof(TestStruct));
 #endif
 
-        Vc::InterleavedMemoryWrapper<TestStruct, V> wrapper(&data[0]);
-#if VC_VERSION_NUMBER >= VC_VERSION_CHECK(0,7,70)
         benchmark_loop(Benchmark("deinterleave (successive)", Repetitions * sizeof(TestStruct), "Byte")) {
             for (int i = 0; i < Repetitions; i += V::Size) {
                 for (int j = 0; j < V::Size; ++j) {
                     asm("":"+m"(data[j]));
                 }
-                deinterleave<COUNT, V>(wrapper, 0);
+                deinterleave<COUNT, V>(&data[0], 0);
             }
         }
         benchmark_loop(Benchmark("interleave (successive)", Repetitions * sizeof(TestStruct), "Byte")) {
@@ -119,16 +147,15 @@ template<typename V> class Runner
                 for (int j = 0; j < V::Size; ++j) {
                     asm("":"+m"(data[j]));
                 }
-                interleave<COUNT, V>(wrapper, 0);
+                interleave<COUNT, V>(&data[0], 0);
             }
         }
-#endif
         benchmark_loop(Benchmark("deinterleave (index vector)", Repetitions * sizeof(TestStruct), "Byte")) {
             for (int i = 0; i < Repetitions; i += V::Size) {
                 for (int j = 0; j < V::Size; ++j) {
                     asm("":"+m"(data[j]));
                 }
-                deinterleave<COUNT, V>(wrapper, I::IndexesFromZero());
+                deinterleave<COUNT, V>(&data[0], I::IndexesFromZero());
             }
         }
         benchmark_loop(Benchmark("interleave (index vector)", Repetitions * sizeof(TestStruct), "Byte")) {
@@ -136,25 +163,23 @@ template<typename V> class Runner
                 for (int j = 0; j < V::Size; ++j) {
                     asm("":"+m"(data[j]));
                 }
-                interleave<COUNT, V>(wrapper, I::IndexesFromZero());
+                interleave<COUNT, V>(&data[0], I::IndexesFromZero());
             }
         }
-#if VC_VERSION_NUMBER >= VC_VERSION_CHECK(0,7,70)
         benchmark_loop(Benchmark("normalize interleaved vectors (successive)", Repetitions * sizeof(TestStruct), "Byte")) {
             for (int i = 0; i < Repetitions; i += V::Size) {
                 for (int j = 0; j < V::Size; ++j) {
                     asm("":"+m"(data[j]));
                 }
-                normalize<COUNT, V>(wrapper, 0);
+                normalize<COUNT, V>(&data[0], 0);
             }
         }
-#endif
         benchmark_loop(Benchmark("normalize interleaved vectors (index vector)", Repetitions * sizeof(TestStruct), "Byte")) {
             for (int i = 0; i < Repetitions; i += V::Size) {
                 for (int j = 0; j < V::Size; ++j) {
                     asm("":"+m"(data[j]));
                 }
-                normalize<COUNT, V>(wrapper, I::IndexesFromZero());
+                normalize<COUNT, V>(&data[0], I::IndexesFromZero());
             }
         }
         benchmark_loop(Benchmark("normalize interleaved vectors (manually)", Repetitions * sizeof(TestStruct), "Byte")) {
@@ -207,6 +232,35 @@ template<typename V> class Runner
                 }
             }
         }
+
+        // random access over an array larger than the caches. The wrapper scales the indexes by
+        // the member count in the index type, so 16-bit indexes only address a cache resident
+        // array: those rows would not measure what their names say and are skipped.
+        typedef typename I::EntryType IT;
+        const size_t largeRecords = largeArrayBytes() / sizeof(TestStruct);
+        if (largeRecords > size_t(std::numeric_limits<IT>::max() / COUNT)) {
+            return;
+        }
+        TestData large(largeRecords);
+        for (int sorted = 0; sorted < 2; ++sorted) {
+            const std::vector<IT> indexes = randomIndexes<IT>(IndexCount, largeRecords, sorted);
+            const std::string which = sorted ? " (sorted random indexes)" : " (random indexes)";
+            benchmark_loop(Benchmark("deinterleave" + which, IndexCount * sizeof(TestStruct), "Byte")) {
+                for (size_t j = 0; j < IndexCount; j += V::Size) {
+                    deinterleave<COUNT, V>(&large[0], I(&indexes[j], Vc::Unaligned));
+                }
+            }
+            benchmark_loop(Benchmark("interleave" + which, IndexCount * sizeof(TestStruct), "Byte")) {
+                for (size_t j = 0; j < IndexCount; j += V::Size) {
+                    interleave<COUNT, V>(&large[0], I(&indexes[j], Vc::Unaligned));
+                }
+            }
+            benchmark_loop(Benchmark("normalize interleaved vectors" + which, IndexCount * sizeof(TestStruct), "Byte")) {
+                for (size_t j = 0; j < IndexCount; j += V::Size) {
+                    normalize<COUNT, V>(&large[0], I(&indexes[j], Vc::Unaligned));
+                }
+            }
+        }
     }
 
 public:
@@ -219,9 +273,91 @@ public:
         runImpl<6>();
         runImpl<7>();
         runImpl<8>();
+        runImpl<16>();
+        runImpl<32>();
     }
 };
 
+/**
+ * A record of 12 float and 4 int members, accessed through index lists: the float members are
+ * normalized, the int members only moved. There is no mixed-type InterleavedMemoryWrapper, so the
+ * int members travel as 32-bit lanes of float_v.
+ */
+class MixedRecords/*{{{*/
+{
+    struct Record
+    {
+        float a[6];
+        int ia[2];
+        float b[6];
+        int ib[2];
+    };
+    enum {
+        Count = sizeof(Record) / sizeof(float)
+    };
+    typedef float_v::IndexType I;
+    typedef I::EntryType IT;
+
+    template <typename Index> static Vc_ALWAYS_INLINE void normalizeFloats(Record *data, const Index &i)
+    {
+        float_v x[Count];
+        deinterleaveChunk<float_v, 0>(data, i, x, std::make_index_sequence<6>());
+        deinterleaveChunk<float_v, 8>(data, i, x, std::make_index_sequence<6>());
+        float_v sum = float_v::Zero();
+        for (int k = 0; k < 6; ++k) {
+            sum += x[k] * x[k] + x[k + 8] * x[k + 8];
+        }
+        const float_v factor = float_v::One() / std::sqrt(sum);
+        for (int k = 0; k < 6; ++k) {
+            x[k] *= factor;
+            x[k + 8] *= factor;
+        }
+        interleaveChunk<float_v, 0>(data, i, x, std::make_index_sequence<6>());
+        interleaveChunk<float_v, 8>(data, i, x, std::make_index_sequence<6>());
+    }
+
+public:
+    static void run()
+    {
+        Benchmark::setColumnData("Member Count", "12 float + 4 int");
+        const size_t records = std::min<size_t>(largeArrayBytes() / sizeof(Record),
+                                                std::numeric_limits<IT>::max() / Count);
+        std::vector<Record> data(records);
+        for (size_t j = 0; j < records; ++j) {
+            for (int k = 0; k < 6; ++k) {
+                data[j].a[k] = k + 1;
+                data[j].b[k] = k + 7;
+            }
+            data[j].ia[0] = data[j].ia[1] = data[j].ib[0] = data[j].ib[1] = j;
+        }
+
+        benchmark_loop(Benchmark("deinterleave (successive)", IndexCount * sizeof(Record), "Byte")) {
+            for (size_t j = 0; j + float_v::Size <= IndexCount; j += float_v::Size) {
+                deinterleave<Count, float_v>(&data[0], j % (records - float_v::Size));
+            }
+        }
+        benchmark_loop(Benchmark("normalize float members (successive)", IndexCount * sizeof(Record), "Byte")) {
+            for (size_t j = 0; j + float_v::Size <= IndexCount; j += float_v::Size) {
+                normalizeFloats(&data[0], j % (records - float_v::Size));
+            }
+        }
+        for (int sorted = 0; sorted < 2; ++sorted) {
+            const std::vector<IT> indexes = randomIndexes<IT>(IndexCount, records, sorted);
+            const std::string which = sorted ? " (sorted random indexes)" : " (random indexes)";
+            benchmark_loop(Benchmark("deinterleave" + which, IndexCount * sizeof(Record), "Byte")) {
+                for (size_t j = 0; j < IndexCount; j += float_v::Size) {
+                    deinterleave<Count, float_v>(&data[0], I(&indexes[j], Vc::Unaligned));
+                }
+            }
+            benchmark_loop(Benchmark("normalize float members" + which, IndexCount * sizeof(Record), "Byte")) {
+                for (size_t j = 0; j < IndexCount; j += float_v::Size) {
+                    normalizeFloats(&data[0], I(&indexes[j], Vc::Unaligned));
+                }
+            }
+        }
+    }
+};/*}}}*/
+
 int bmain()
 {
     Benchmark::addColumn("datatype");
@@ -231,11 +367,11 @@ int bmain()
     Runner<float_v>::run();
     Benchmark::setColumnData("datatype", "double_v");
     Runner<double_v>::run();
-    Benchmark::setColumnData("datatype", "sfloat_v");
-    Runner<sfloat_v>::run();
     Benchmark::setColumnData("datatype", "int_v");
     Runner<int_v>::run();
     Benchmark::setColumnData("datatype", "short_v");
     Runner<short_v>::run();
+    Benchmark::setColumnData("datatype", "float_v");
+    MixedRecords::run();
     return 0;
 }
@@ -0,0 +1,242 @@
+/*  This file is part of the Vc library.
+
+    Copyright (C) 2016 Matthias Kretz <kretz@kde.org>
+
+    Vc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    Vc is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Vc.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <Vc/Vc>
+#include "benchmark.h"
+#include "interleavedchunks.h"
+#include <Vc/cpuid.h>
+
+using namespace Vc;
+
+/*
+ * The same records of Members values each, stored as
+ *   AoS:   struct { T x[Members]; } data[N], accessed through InterleavedMemoryWrapper (in chunks
+ *          of at most MaxChunk members, cf. interleavedchunks.h),
+ *   SoA:   T x[Members][N],
+ *   AoSoA: struct { T x[Members][V::Size]; } data[N / V::Size],
+ * and processed by the deinterleave, interleave and normalize kernels of
+ * interleavedmemorywrapper.cpp over working sets from L1 to main memory.
+ *
+ * The Byte unit counts the bytes the kernel reads plus the bytes it writes;
+ * Op/s = Byte/s / Byte/Op, where an Op is one value moved for (de)interleave and one FLOP for
+ * normalize.
+ */
+
+template <typename V, int Members> class Layouts/*{{{*/
+{
+    typedef typename V::EntryType T;
+
+    struct Record
+    {
+        T x[Members];
+    };
+
+    struct AoS
+    {
+        static const char *name() { return "AoS"; }
+        AoS(T *mem, size_t) : data(reinterpret_cast<Record *>(mem)) {}
+
+        Vc_ALWAYS_INLINE void load(V *x, size_t i)
+        {
+            Chunks<V, 0, Members>::deinterleave(data, i, x);
+        }
+        Vc_ALWAYS_INLINE void store(V *x, size_t i)
+        {
+            Chunks<V, 0, Members>::interleave(data, i, x);
+        }
+
+        Record *const data;
+    };
+
+    struct SoA
+    {
+        static const char *name() { return "SoA"; }
+        SoA(T *mem, size_t n) : data(mem), size(n) {}
+
+        Vc_ALWAYS_INLINE void load(V *x, size_t i)
+        {
+            for (int k = 0; k < Members; ++k) {
+                x[k].load(&data[k * size + i]);
+            }
+        }
+        Vc_ALWAYS_INLINE void store(V *x, size_t i)
+        {
+            for (int k = 0; k < Members; ++k) {
+                x[k].store(&data[k * size + i]);
+            }
+        }
+
+        T *const data;
+        const size_t size;
+    };
+
+    struct AoSoA
+    {
+        static const char *name() { return "AoSoA"; }
+        AoSoA(T *mem, size_t) : data(mem) {}
+
+        Vc_ALWAYS_INLINE void load(V *x, size_t i)
+        {
+            T *block = &data[i * Members];
+            for (int k = 0; k < Members; ++k) {
+                x[k].load(&block[k * V::Size]);
+            }
+        }
+        Vc_ALWAYS_INLINE void store(V *x, size_t i)
+        {
+            T *block = &data[i * Members];
+            for (int k = 0; k < Members; ++k) {
+                x[k].store(&block[k * V::Size]);
+            }
+        }
+
+        T *const data;
+    };
+
+    static std::string toString(double x)
+    {
+        std::ostringstream s;
+        s << x;
+        return s.str();
+    }
+
+    template <typename Layout> static void runLayout(T *mem, size_t n, int repetitions)
+    {
+        Benchmark::setColumnData("layout", Layout::name());
+        Layout layout(mem, n);
+        const double bytes = double(n) * Members * sizeof(T) * repetitions;
+
+        Benchmark::setColumnData("Byte/Op", toString(sizeof(T)));
+        benchmark_loop(Benchmark("deinterleave", bytes, "Byte")) {
+            for (int rep = 0; rep < repetitions; ++rep) {
+                for (size_t i = 0; i < n; i += V::Size) {
+                    V x[Members];
+                    layout.load(x, i);
+                    for (int k = 0; k < Members; ++k) {
+                        keepResults(x[k]);
+                    }
+                }
+            }
+        }
+
+        benchmark_loop(Benchmark("interleave", bytes, "Byte")) {
+            V x[Members];
+            for (int k = 0; k < Members; ++k) {
+                x[k] = T(k + 1);
+            }
+            for (int rep = 0; rep < repetitions; ++rep) {
+                for (size_t i = 0; i < n; i += V::Size) {
+                    layout.store(x, i);
+                }
+            }
+        }
+
+        // Members mul + (Members - 1) add + sqrt + div + Members mul per record, reading and
+        // writing the record
+        Benchmark::setColumnData("Byte/Op", toString(2. * Members * sizeof(T) / (3 * Members + 1)));
+        benchmark_loop(Benchmark("normalize", 2 * bytes, "Byte")) {
+            for (int rep = 0; rep < repetitions; ++rep) {
+                for (size_t i = 0; i < n; i += V::Size) {
+                    V x[Members];
+                    layout.load(x, i);
+                    V sum = x[0] * x[0];
+                    for (int k = 1; k < Members; ++k) {
+                        sum += x[k] * x[k];
+                    }
+                    const V factor = V::One() / std::sqrt(sum);
+                    for (int k = 0; k < Members; ++k) {
+                        x[k] *= factor;
+                    }
+                    layout.store(x, i);
+                }
+            }
+        }
+    }
+
+    static void run(size_t bytes)
+    {
+        // same amount of work for every working set size
+        const int repetitions = std::max<size_t>(1, (64u << 20) / bytes);
+        const size_t n = bytes / (Members * sizeof(T)) / V::Size * V::Size;
+        T *mem = Vc::malloc<T, Vc::AlignOnPage>(n * Members);
+        for (size_t i = 0; i < n * Members; ++i) {
+            mem[i] = T(i % Members + 1);
+        }
+#ifndef VC_BENCHMARK_NO_MLOCK
+        mlock(mem, n * Members * sizeof(T));
+#endif
+        runLayout<AoS>(mem, n, repetitions);
+        runLayout<SoA>(mem, n, repetitions);
+        runLayout<AoSoA>(mem, n, repetitions);
+#ifndef VC_BENCHMARK_NO_MLOCK
+        munlock(mem, n * Members * sizeof(T));
+#endif
+        Vc::free(mem);
+    }
+
+public:
+    static void run()
+    {
+        std::ostringstream str;
+        str << Members;
+        Benchmark::setColumnData("Member Count", str.str());
+
+        Benchmark::setColumnData("MemorySize", "half L1");
+        run(CpuId::L1Data() / 2);
+        Benchmark::setColumnData("MemorySize", "L1");
+        run(CpuId::L1Data());
+        Benchmark::setColumnData("MemorySize", "half L2");
+        run(CpuId::L2Data() / 2);
+        Benchmark::setColumnData("MemorySize", "L2");
+        run(CpuId::L2Data());
+        if (CpuId::L3Data() > 0) {
+            Benchmark::setColumnData("MemorySize", "half L3");
+            run(CpuId::L3Data() / 2);
+            Benchmark::setColumnData("MemorySize", "L3");
+            run(CpuId::L3Data());
+            Benchmark::setColumnData("MemorySize", "4x L3");
+            run(size_t(CpuId::L3Data()) * 4);
+        } else {
+            Benchmark::setColumnData("MemorySize", "4x L2");
+            run(size_t(CpuId::L2Data()) * 4);
+        }
+    }
+};/*}}}*/
+
+template <typename V> static void runAll()
+{
+    Layouts<V, 3>::run();
+    Layouts<V, 8>::run();
+    Layouts<V, 16>::run();
+}
+
+int bmain()
+{
+    Benchmark::addColumn("datatype");
+    Benchmark::addColumn("Member Count");
+    Benchmark::addColumn("MemorySize");
+    Benchmark::addColumn("layout");
+    Benchmark::addColumn("Byte/Op");
+
+    Benchmark::setColumnData("datatype", "float_v");
+    runAll<float_v>();
+    Benchmark::setColumnData("datatype", "double_v");
+    runAll<double_v>();
+    return 0;
+}
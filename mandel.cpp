@@ -23,6 +23,7 @@
 
 #include "mandel.h"
 #include <Vc/Vc>
+#include <type_traits>
 
 using Vc::float_v;
 using Vc::float_m;
@@ -77,24 +78,42 @@ template<typename T> inline MyComplex<T> P(MyComplex<T> z, T c_real, T c_imag)
 }
 //! [P function]
 
-template <>
-void mandelMe<VcImpl>(Image &image, float x0, float y0, float scale, int maxIt)
+// counts the lanes that do useful iterations, for mandelLaneUtilization
+struct NoLaneCount
+{
+    void step(float_m) {}
+};
+struct LaneCount
+{
+    void step(float_m running)
+    {
+        useful += running.count();
+        slots += float_v::Size;
+    }
+    unsigned long long useful = 0, slots = 0;
+};
+
+template <typename Counter>
+static void vcTile(Image &image, int left, int top, int width, int height, float x0, float y0,
+                   float scale, int maxIt, Counter &counter)
 {
     typedef MyComplex<float_v> Z;
-    const unsigned int height = image.height;
-    const unsigned int width = image.width;
+    const unsigned int bottom = top + height;
+    const unsigned int right = left + width;
     const float_v colorScale = 0xff / static_cast<float>(maxIt);
-    for (unsigned int y = 0; y < height; ++y) {
-        unsigned int *Vc_RESTRICT line = image.scanLine(y);
+    for (unsigned int y = top; y < bottom; ++y) {
+        unsigned int *Vc_RESTRICT line = image.scanLine(y) + left;
         const float_v c_imag = y0 + y * scale;
         uint_m toStore;
-        for (uint_v x = uint_v::IndexesFromZero(); !(toStore = x < width).isEmpty();
+        for (uint_v x = uint_v::IndexesFromZero() + uint_v(left); !(toStore = x < right).isEmpty();
                 x += float_v::Size) {
             const float_v c_real = x0 + Vc::simd_cast<float_v>(x) * scale;
             Z z(c_real, c_imag);
             float_v n = float_v::Zero();
             float_m inside = z.norm() < S;
-            while (!(inside && n < maxIt).isEmpty()) {
+            float_m running;
+            while (!(running = inside && n < maxIt).isEmpty()) {
+                counter.step(running);
                 z = P(z, c_real, c_imag);
                 ++n(inside);
                 inside = z.norm() < S;
@@ -111,17 +130,112 @@ void mandelMe<VcImpl>(Image &image, float x0, float y0, float scale, int maxIt)
     }
 }
 
+/**
+ * Like vcTile, but the lanes work on the pixels of the tile independently: whenever a lane's
+ * pixel is finished its color is stored with a masked scatter and the lane is refilled with the
+ * next pixel from the tile, instead of idling until the slowest lane of the group has finished.
+ * A refill costs a log2(N) step prefix sum over the mask, a division and a scatter.
+ */
+template <typename Counter>
+static void refillTile(Image &image, int left, int top, int width, int height, float x0,
+                       float y0, float scale, int maxIt, Counter &counter)
+{
+    enum { N = float_v::Size };
+    const unsigned int count = width * height;
+    const float_v colorScale = 0xff / static_cast<float>(maxIt);
+    const float_v w = static_cast<float>(width);
+    unsigned int next = 0;
+
+    // the pixel of every lane, as index into the tile (exact in float, a tile has < 2^24 pixels)
+    float_v pixel = float_v::Zero();
+    float_v c_real = float_v::Zero(), c_imag = float_v::Zero();
+    float_v z_real = float_v::Zero(), z_imag = float_v::Zero();
+    float_v z_real2 = float_v::Zero(), z_imag2 = float_v::Zero();
+    float_v n = float_v::Zero();
+    uint_v offset = uint_v::Zero();
+    float_m active(false);
+    float_m done(true);
+    for (;;) {
+        if (!done.isEmpty()) {
+            const float_m store = done && active;
+            if (!store.isEmpty()) {
+                const uint_v colorValue = static_cast<uint_v>((maxIt - n) * colorScale) * 0x10101;
+                colorValue.scatter(&image.pixels[0], offset, Vc::simd_cast<uint_m>(store));
+            }
+            // the done lanes take the next pixels of the tile in lane order: the rank of a lane
+            // among the done lanes is the exclusive prefix sum of the mask
+            float_v doneLanes = float_v::Zero();
+            doneLanes(done) = float_v::One();
+            float_v rank = doneLanes;
+            for (int k = 1; k < N; k *= 2) {
+                rank += rank.shifted(-k);
+            }
+            pixel(done) = static_cast<float>(next) + rank - doneLanes;
+            next += done.count();
+
+            float_v y = Vc::floor(pixel / w);
+            float_v x = pixel - y * w;
+            // pixel / w may round up to the next integer
+            const float_m wrapped = x < 0.f;
+            y(wrapped) -= 1.f;
+            x(wrapped) += w;
+            const uint_m doneU = Vc::simd_cast<uint_m>(done);
+            offset(doneU) = (Vc::simd_cast<uint_v>(y) + top) * image.width +
+                            Vc::simd_cast<uint_v>(x) + left;
+            c_real(done) = x0 + (x + static_cast<float>(left)) * scale;
+            c_imag(done) = y0 + (y + static_cast<float>(top)) * scale;
+            z_real(done) = c_real;
+            z_imag(done) = c_imag;
+            n(done) = float_v::Zero();
+            active = (active && !done) || (done && pixel < static_cast<float>(count));
+            z_real2 = z_real * z_real;
+            z_imag2 = z_imag * z_imag;
+            // a new pixel may already be outside
+            done = active && !(z_real2 + z_imag2 < S && n < maxIt);
+            continue;
+        }
+        if (active.isEmpty()) {
+            break;
+        }
+        counter.step(active);
+        const float_v real = z_real2 + c_real - z_imag2;
+        z_imag = (z_real + z_real) * z_imag + c_imag;
+        z_real = real;
+        z_real2 = z_real * z_real;
+        z_imag2 = z_imag * z_imag;
+        ++n(active);
+        done = active && !(z_real2 + z_imag2 < S && n < maxIt);
+    }
+}
+
+template <>
+void mandelTile<VcImpl>(Image &image, int left, int top, int width, int height, float x0, float y0,
+                        float scale, int maxIt)
+{
+    NoLaneCount counter;
+    vcTile(image, left, top, width, height, x0, y0, scale, maxIt, counter);
+}
+
 template <>
-void mandelMe<ScalarImpl>(Image &image, float x0, float y0, float scale, int maxIt)
+void mandelTile<VcRefillImpl>(Image &image, int left, int top, int width, int height, float x0,
+                              float y0, float scale, int maxIt)
+{
+    NoLaneCount counter;
+    refillTile(image, left, top, width, height, x0, y0, scale, maxIt, counter);
+}
+
+template <>
+void mandelTile<ScalarImpl>(Image &image, int left, int top, int width, int height, float x0,
+                            float y0, float scale, int maxIt)
 {
     typedef MyComplex<float> Z;
-    const int height = image.height;
-    const int width = image.width;
+    const int bottom = top + height;
+    const int right = left + width;
     const float colorScale = 0xff / static_cast<float>(maxIt);
-    for (int y = 0; y < height; ++y) {
-        unsigned int *Vc_RESTRICT line = image.scanLine(y);
+    for (int y = top; y < bottom; ++y) {
+        unsigned int *Vc_RESTRICT line = image.scanLine(y) + left;
         const float c_imag = y0 + y * scale;
-        for (int x = 0; x < width; ++x) {
+        for (int x = left; x < right; ++x) {
             const float c_real = x0 + x * scale;
             Z z(c_real, c_imag);
             int n = 0;
@@ -133,4 +247,183 @@ void mandelMe<ScalarImpl>(Image &image, float x0, float y0, float scale, int max
     }
 }
 
+template <MandelImpl Impl>
+void mandelMe(Image &image, float x0, float y0, float scale, int maxIt)
+{
+    mandelTile<Impl>(image, 0, 0, image.width, image.height, x0, y0, scale, maxIt);
+}
+
+template <>
+double mandelLaneUtilization<VcImpl>(Image &image, float x0, float y0, float scale, int maxIt)
+{
+    LaneCount counter;
+    vcTile(image, 0, 0, image.width, image.height, x0, y0, scale, maxIt, counter);
+    return counter.slots ? double(counter.useful) / counter.slots : 1.;
+}
+
+template <>
+double mandelLaneUtilization<VcRefillImpl>(Image &image, float x0, float y0, float scale, int maxIt)
+{
+    LaneCount counter;
+    refillTile(image, 0, 0, image.width, image.height, x0, y0, scale, maxIt, counter);
+    return counter.slots ? double(counter.useful) / counter.slots : 1.;
+}
+
+template <>
+double mandelLaneUtilization<ScalarImpl>(Image &, float, float, float, int)
+{
+    return 1.;
+}
+
+template void mandelMe<VcImpl>(Image &, float, float, float, int);
+template void mandelMe<VcRefillImpl>(Image &, float, float, float, int);
+template void mandelMe<ScalarImpl>(Image &, float, float, float, int);
+
+/**
+ * The kernel for arbitrary vector types and long iteration counts. Lanes that escaped, ran into
+ * a cycle, or were rejected up front as inside stop counting, but keep iterating until the whole
+ * vector is done, as in vcTile.
+ */
+template <typename V>
+static unsigned long long mandelDeepImpl(Image &image, const Viewport &view,
+                                         MandelOptions options, std::false_type)
+{
+    typedef typename V::EntryType T;
+    typedef typename V::mask_type M;
+    typedef Vc::SimdArray<unsigned int, V::size()> UV;
+    typedef typename UV::mask_type UM;
+
+    const T maxIt = view.maxIterations;
+    const V colorScale = 0xff / maxIt;
+    const T scale = view.scale;
+    const unsigned int width = image.width;
+    unsigned long long iterations = 0;
+    for (int y = 0; y < image.height; ++y) {
+        unsigned int *Vc_RESTRICT line = image.scanLine(y);
+        const V c_imag = T(view.y + y * view.scale);
+        for (unsigned int x = 0; x < width; x += V::size()) {
+            const V c_real = T(view.x) + (V::IndexesFromZero() + T(x)) * scale;
+            V z_real = c_real, z_imag = c_imag;
+            V z_real2 = z_real * z_real, z_imag2 = z_imag * z_imag;
+            V n = V::Zero();
+
+            M trapped(false);
+            if (options.rejectCardioidAndBulb) {
+                const V xq = c_real - T(0.25);
+                const V q = xq * xq + z_imag2;
+                const V xb = c_real + T(1);
+                trapped = q * (q + xq) <= T(0.25) * z_imag2 || xb * xb + z_imag2 <= T(1. / 16.);
+            }
+
+            // Brent's cycle detection: compare against a saved z that is replaced at doubling
+            // intervals
+            V saved_real = z_real, saved_imag = z_imag;
+            int sinceSave = 0, saveInterval = 8;
+
+            M running = !trapped && z_real2 + z_imag2 < T(S);
+            while (!running.isEmpty()) {
+                const V real = z_real2 + c_real - z_imag2;
+                z_imag = (z_real + z_real) * z_imag + c_imag;
+                z_real = real;
+                z_real2 = z_real * z_real;
+                z_imag2 = z_imag * z_imag;
+                ++n(running);
+                running = running && z_real2 + z_imag2 < T(S) && n < maxIt;
+                if (options.checkPeriodicity) {
+                    const M cycle = running && z_real == saved_real && z_imag == saved_imag;
+                    trapped = trapped || cycle;
+                    running = running && !cycle;
+                    if (++sinceSave == saveInterval) {
+                        saved_real = z_real;
+                        saved_imag = z_imag;
+                        sinceSave = 0;
+                        saveInterval *= 2;
+                    }
+                }
+            }
+
+            const M valid = V::IndexesFromZero() + T(x) < T(width);
+            iterations += static_cast<unsigned long long>(Vc::iif(valid, n, V::Zero()).sum());
+            const UV colorValue =
+                Vc::simd_cast<UV>((maxIt - Vc::iif(trapped, V(maxIt), n)) * colorScale) * 0x10101;
+            const UM toStore = UV::IndexesFromZero() + x < width;
+            if (toStore.isFull()) {
+                colorValue.store(line + x, Vc::Unaligned);
+            } else {
+                colorValue.store(line + x, toStore, Vc::Unaligned);
+            }
+        }
+    }
+    return iterations;
+}
+
+template <typename T>
+static unsigned long long mandelDeepImpl(Image &image, const Viewport &view,
+                                         MandelOptions options, std::true_type)
+{
+    const T colorScale = 0xff / static_cast<T>(view.maxIterations);
+    const T scale = view.scale;
+    unsigned long long iterations = 0;
+    for (int y = 0; y < image.height; ++y) {
+        unsigned int *Vc_RESTRICT line = image.scanLine(y);
+        const T c_imag = T(view.y + y * view.scale);
+        for (int x = 0; x < image.width; ++x) {
+            const T c_real = T(view.x) + T(x) * scale;
+            T z_real = c_real, z_imag = c_imag;
+            T z_real2 = z_real * z_real, z_imag2 = z_imag * z_imag;
+            int n = 0;
+
+            bool trapped = false;
+            if (options.rejectCardioidAndBulb) {
+                const T xq = c_real - T(0.25);
+                const T q = xq * xq + z_imag2;
+                const T xb = c_real + T(1);
+                trapped = q * (q + xq) <= T(0.25) * z_imag2 || xb * xb + z_imag2 <= T(1. / 16.);
+            }
+
+            T saved_real = z_real, saved_imag = z_imag;
+            int sinceSave = 0, saveInterval = 8;
+
+            if (!trapped) {
+                for (; z_real2 + z_imag2 < T(S) && n < view.maxIterations;) {
+                    const T real = z_real2 + c_real - z_imag2;
+                    z_imag = (z_real + z_real) * z_imag + c_imag;
+                    z_real = real;
+                    z_real2 = z_real * z_real;
+                    z_imag2 = z_imag * z_imag;
+                    ++n;
+                    if (options.checkPeriodicity) {
+                        if (z_real == saved_real && z_imag == saved_imag) {
+                            trapped = true;
+                            break;
+                        }
+                        if (++sinceSave == saveInterval) {
+                            saved_real = z_real;
+                            saved_imag = z_imag;
+                            sinceSave = 0;
+                            saveInterval *= 2;
+                        }
+                    }
+                }
+            }
+            iterations += n;
+            *line++ = static_cast<unsigned int>((view.maxIterations - (trapped ? view.maxIterations : n)) *
+                                                colorScale) * 0x10101;
+        }
+    }
+    return iterations;
+}
+
+template <typename V>
+unsigned long long mandelDeep(Image &image, const Viewport &view, MandelOptions options)
+{
+    return mandelDeepImpl<V>(image, view, options, std::is_arithmetic<V>());
+}
+
+template unsigned long long mandelDeep<float_v>(Image &, const Viewport &, MandelOptions);
+template unsigned long long mandelDeep<Vc::double_v>(Image &, const Viewport &, MandelOptions);
+template unsigned long long mandelDeep<Vc::SimdArray<double, float_v::size()>>(Image &, const Viewport &, MandelOptions);
+template unsigned long long mandelDeep<float>(Image &, const Viewport &, MandelOptions);
+template unsigned long long mandelDeep<double>(Image &, const Viewport &, MandelOptions);
+
 // vim: sw=4 sts=4 et tw=100
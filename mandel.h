@@ -24,7 +24,7 @@
 #include <vector>
 
 enum MandelImpl {
-    VcImpl, ScalarImpl
+    VcImpl, ScalarImpl, VcRefillImpl
 };
 
 struct Image {
@@ -38,3 +38,28 @@ struct Image {
 template <MandelImpl Impl>
 void mandelMe(Image &image, float x, float y, float scale, int maxIterations);
 
+// renders only the given rectangle of pixels; pixel (i, j) gets the same value as from mandelMe
+template <MandelImpl Impl>
+void mandelTile(Image &image, int left, int top, int width, int height, float x, float y,
+                float scale, int maxIterations);
+
+// renders the image like mandelMe and returns the fraction of SIMD lanes that did useful iterations
+template <MandelImpl Impl>
+double mandelLaneUtilization(Image &image, float x, float y, float scale, int maxIterations);
+
+// the upper left corner and the distance between neighboring pixels in the complex plane
+struct Viewport {
+  double x, y, scale;
+  int maxIterations;
+};
+
+struct MandelOptions {
+  bool rejectCardioidAndBulb;  // points in the main cardioid and the period-2 bulb are inside
+  bool checkPeriodicity;       // stop iterating once z runs into a cycle
+};
+
+// renders with the precision and width of V (float_v, double_v, a SimdArray, or float/double for
+// scalar code) and returns the number of iterations executed
+template <typename V>
+unsigned long long mandelDeep(Image &image, const Viewport &view, MandelOptions options);
+
@@ -18,210 +18,507 @@
 
 */
 
-#include "tsc.h"
+#include "benchmark.h"
 #include "mandel.h"
-#include <cstdio>
-#include <cstring>
-#include <iostream>
+#include "threads.h"
+#include "tsc.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#if !defined _WIN32 && !defined _WIN64
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
-#include <Vc/global.h>
-#include <Vc/support.h>
-
-class Output
-{
-    public:
-        Output(int cols) : m_fd(stdout), m_cols(cols), m_col(0) {}
-        ~Output();
-
-        void open(const char * = 0);
-
-        Output &operator<<(int);
-        Output &operator<<(unsigned long long);
-        Output &operator<<(float);
-        Output &operator<<(double);
-        Output &operator<<(bool);
-        Output &operator<<(const char *);
+#define VC_BENCHMARK_HAVE_ZOOM 1
+#endif
 
-    private:
-        Output &foo();
+SET_HELP_TEXT("  --tile-size <n>      edge length of the tiles in the parallel mode (default: 32)\n"
+              "  --zoom-output <file> keep the frames of the zoom animation as a PPM stream in <file>\n"
+              "                       (default: a temporary file in the current directory)\n");
 
-        FILE *m_fd;
-        int m_cols;
-        int m_col;
-};
+extern std::vector<std::string> g_arguments;
 
-Output::~Output()
+static int tileSize()
 {
-    if (m_fd) {
-        if (m_fd != stdout) {
-            fclose(m_fd);
+    int size = 32;
+    for (std::size_t i = 0; i + 1 < g_arguments.size(); ++i) {
+        if (g_arguments[i] == "--tile-size") {
+            size = std::max(1, std::atoi(g_arguments[i + 1].c_str()));
         }
-        m_fd = 0;
     }
+    return size;
 }
 
-void Output::open(const char *filename)
+static std::string zoomOutput()
 {
-    if (filename) {
-        m_fd = fopen(filename, "w+");
-    } else {
-        m_fd = stdout;
+    std::string path;
+    for (std::size_t i = 0; i + 1 < g_arguments.size(); ++i) {
+        if (g_arguments[i] == "--zoom-output") {
+            path = g_arguments[i + 1];
+        }
     }
+    return path;
 }
 
-Output &Output::operator<<(int x)
+static const char *implName(MandelImpl impl)
 {
-    fprintf(m_fd, "%10d", x);
-    return foo();
+    switch (impl) {
+    case VcImpl:
+        return "Vc";
+    case VcRefillImpl:
+        return "Vc (lane refill)";
+    case ScalarImpl:
+        break;
+    }
+    return "Scalar";
 }
 
-Output &Output::operator<<(unsigned long long x)
+/**
+ * Renders the image with \p threadCount threads, which take square tiles of \p tileSize pixels
+ * from a work-stealing scheduler. The cost per tile varies by orders of magnitude across the
+ * image, which a static partitioning could not balance. The threads are spawned and joined in
+ * every call, so thread start-up is part of the measured cycles, as it is for a caller that
+ * renders a single image in parallel.
+ */
+template <MandelImpl Impl>
+static void mandelParallel(Image &image, float x, float y, float scale, int maxIterations,
+                           int threadCount, int tileSize)
 {
-    fprintf(m_fd, "%14lld", x);
-    return foo();
+    const int tilesX = (image.width + tileSize - 1) / tileSize;
+    const int tilesY = (image.height + tileSize - 1) / tileSize;
+    runWorkStealing(threadCount, tilesX * tilesY, [&](int tile, int) {
+        const int left = tile % tilesX * tileSize;
+        const int top = tile / tilesX * tileSize;
+        mandelTile<Impl>(image, left, top, std::min(tileSize, image.width - left),
+                         std::min(tileSize, image.height - top), x, y, scale, maxIterations);
+    });
 }
 
-Output &Output::operator<<(float x)
+struct View
 {
-    fprintf(m_fd, "%10f", x);
-    return foo();
-}
+    explicit View(int size) : width(3 * size), height(2 * size), scale(1.f / size) {}
+    const int width, height;
+    const float x = -2.f;
+    const float y = -1.f;
+    const float scale;
+    const int maxIterations = 255;
+    double pixels() const { return double(width) * height; }
+};
 
-Output &Output::operator<<(double x)
+template <MandelImpl Impl> static void runSerial(const View &view)
 {
-    fprintf(m_fd, "%14f", x);
-    return foo();
+    Benchmark::setColumnData("Implementation", implName(Impl));
+    Image image{view.width, view.height};
+    std::ostringstream str;
+    str << mandelLaneUtilization<Impl>(image, view.x, view.y, view.scale, view.maxIterations);
+    Benchmark::setColumnData("lane utilization", str.str());
+    benchmark_loop(Benchmark("mandelbrot", view.pixels(), "Pixel")) {
+        mandelMe<Impl>(image, view.x, view.y, view.scale, view.maxIterations);
+    }
 }
 
-Output &Output::operator<<(const char *x)
+/**
+ * The work-stealing renderer on 1..N cores. The speedup column is the mean cycles per pixel of
+ * the serial mandelMe of the same implementation (the "serial reference" row) over the mean
+ * cycles per pixel on N cores, i.e. it includes the cost of tiling, scheduling and thread
+ * start-up.
+ */
+template <MandelImpl Impl> static void runParallel(const View &view, int tileSize)
 {
-    fprintf(m_fd, "\"%s\"", x);
-    return foo();
-}
+    Benchmark::setColumnData("Implementation", implName(Impl));
 
-Output &Output::operator<<(bool x)
-{
-    fprintf(m_fd, "%d", x);
-    return foo();
+    Benchmark::setColumnData("threads", "1");
+    Benchmark::setColumnData("speedup", "1");
+    Benchmark::setColumnData("equal", "yes");
+    Image reference{view.width, view.height};
+    benchmark_loop(Benchmark("mandelbrot (serial reference)", view.pixels(), "Pixel")) {
+        mandelMe<Impl>(reference, view.x, view.y, view.scale, view.maxIterations);
+    }
+    const double serialCycles = Benchmark::lastCyclesPerUnit();
+    if (serialCycles == 0.) { // the reference was skipped
+        mandelMe<Impl>(reference, view.x, view.y, view.scale, view.maxIterations);
+    }
+
+    for (int threadCount : threadCountsToTest()) {
+        std::ostringstream str;
+        str << threadCount;
+        Benchmark::setColumnData("threads", str.str());
+
+        Image image{view.width, view.height};
+        Benchmark timer("mandelbrot (work stealing)", view.pixels(), "Pixel");
+        TimeStampCounter tsc;
+        double cycles = 0.;
+        int dataPoints = 0;
+        while (timer.wantsMoreDataPoints()) {
+            timer.Start();
+            tsc.Start();
+            mandelParallel<Impl>(image, view.x, view.y, view.scale, view.maxIterations,
+                                 threadCount, tileSize);
+            tsc.Stop();
+            timer.Stop();
+            cycles += tsc.Cycles();
+            ++dataPoints;
+        }
+        str.str(std::string());
+        str << (dataPoints > 0 && serialCycles > 0.
+                    ? serialCycles * view.pixels() * dataPoints / cycles
+                    : 0.);
+        Benchmark::setColumnData("speedup", str.str());
+        Benchmark::setColumnData("equal", image == reference ? "yes" : "no");
+        timer.Print();
+    }
 }
 
-Output &Output::foo()
+/**
+ * A view of width 3 × height 2 around the given center, with the real part spanning \p span,
+ * for an image of 3 * size × 2 * size pixels.
+ */
+struct DeepView
 {
-    if (++m_col == m_cols) {
-        m_col = 0;
-        fprintf(m_fd, "\n");
-        fflush(m_fd);
-    } else {
-        fprintf(m_fd, " ");
+    const char *name;
+    double centerX, centerY, span;
+    int maxIterations;
+
+    Viewport viewport(int size) const
+    {
+        const double scale = span / (3 * size);
+        return {centerX - 1.5 * size * scale, centerY - size * scale, scale, maxIterations};
     }
-    return *this;
+};
+
+static const char *earlyOutsName(MandelOptions options)
+{
+    return options.rejectCardioidAndBulb
+               ? (options.checkPeriodicity ? "cardioid/bulb + periodicity" : "cardioid/bulb")
+               : (options.checkPeriodicity ? "periodicity" : "none");
 }
 
-void usage(char **argv)
+/**
+ * Renders \p view with the precision and width of V. Reports Pixels in the Benchmark row and
+ * the executed iterations per second in the "Iterations/s" column. The image is compared
+ * against \p reference, which is rendered in scalar double without early-outs.
+ */
+template <typename V>
+static void runDeep(const char *datatype, const char *implementation, const Viewport &view,
+                    MandelOptions options, const Image &reference)
 {
-    printf("Usage: %s [<options>]\n\n", argv[0]);
-    printf("Options:\n");
-    printf("  -h|--help           print this message\n");
-    printf("  -o|--output <file>  output measurements to file\n\n");
+    Benchmark::setColumnData("datatype", datatype);
+    Benchmark::setColumnData("Implementation", implementation);
+    Benchmark::setColumnData("early-outs", earlyOutsName(options));
+
+    Image image{reference.width, reference.height};
+    Benchmark timer("mandelbrot (deep zoom)", double(image.width) * image.height, "Pixel");
+    double seconds = 0.;
+    double iterations = 0.;
+    while (timer.wantsMoreDataPoints()) {
+        timer.Start();
+        const auto t0 = std::chrono::steady_clock::now();
+        iterations += mandelDeep<V>(image, view, options);
+        const auto t1 = std::chrono::steady_clock::now();
+        timer.Stop();
+        seconds += std::chrono::duration<double>(t1 - t0).count();
+    }
+    std::ostringstream str;
+    str << (seconds > 0. ? iterations / seconds : 0.);
+    Benchmark::setColumnData("Iterations/s", str.str());
+    Benchmark::setColumnData("equal", image == reference ? "yes" : "no");
+    timer.Print();
 }
 
-int main(int argc, char **argv)
+#ifdef VC_BENCHMARK_HAVE_ZOOM
+/**
+ * A sequence of binary PPM frames in one pre-sized, mmap'd file. Without a path the file is a
+ * temporary that is removed again.
+ */
+class PpmStream
 {
-    if (!Vc::currentImplementationSupported()) {
-        std::cerr << "CPU or OS requirements not met for the compiled in vector unit!\n";
-        return -1;
+public:
+    PpmStream(const std::string &path, int frames, int width, int height)
+        : m_path(path.empty() ? "mandelbrot-zoom-XXXXXX" : path), m_keep(!path.empty())
+    {
+        std::ostringstream header;
+        header << "P6\n" << width << ' ' << height << "\n255\n";
+        m_header = header.str();
+        m_frameBytes = m_header.size() + std::size_t(width) * height * 3;
+        m_size = m_frameBytes * frames;
+        if (m_keep) {
+            m_fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        } else {
+            m_fd = mkstemp(&m_path[0]);
+        }
+        if (m_fd < 0 || ftruncate(m_fd, m_size) != 0) {
+            return;
+        }
+        void *map = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        m_data = map == MAP_FAILED ? 0 : static_cast<unsigned char *>(map);
     }
 
-#ifdef SCHED_FIFO_BENCHMARKS
-    if (SCHED_FIFO != sched_getscheduler(0)) {
-        char *path = reinterpret_cast<char *>(malloc(strlen(argv[0] + sizeof("rtwrapper"))));
-        strcpy(path, argv[0]);
-        char *slash = strrchr(path, '/');
-        if (slash) {
-            slash[1] = '\0';
+    ~PpmStream()
+    {
+        if (m_data) {
+            munmap(m_data, m_size);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+            if (!m_keep) {
+                unlink(m_path.c_str());
+            }
         }
-        strcat(path, "rtwrapper");
-        // not realtime priority, check whether the benchmark executable exists
-        execv(path, argv);
-        free(path);
-        // if the execv call works, great. If it doesn't we just continue, but without realtime prio
     }
-#endif
 
-    TimeStampCounter tsc;
-
-    Output out(4);
-    for (int i = 1; i < argc; ++i) {
-        switch (argv[i][0]) {
-        case '-':
-            switch (argv[i][1]) {
-            case 'o':
-                if (argv[i][2] == '\0') {
-                    if (++i < argc) {
-                        out.open(argv[i]);
-                    } else {
-                        usage(argv);
-                        return 1;
-                    }
-                } else {
-                    out.open(&argv[i][2]);
+    bool isValid() const { return m_data != 0; }
+
+    /**
+     * Converts \p image into the mapping and writes the pages of the frame back to the file, so
+     * that the time for a frame includes the actual I/O. The default output is in the current
+     * directory rather than in /tmp, which often is a tmpfs.
+     */
+    void write(int frame, const Image &image)
+    {
+        unsigned char *const begin = m_data + m_frameBytes * frame;
+        unsigned char *out = begin;
+        std::memcpy(out, m_header.data(), m_header.size());
+        out += m_header.size();
+        for (unsigned int pixel : image.pixels) {
+            *out++ = pixel >> 16;
+            *out++ = pixel >> 8;
+            *out++ = pixel;
+        }
+        // msync wants a page-aligned address; the first page may hold the end of the previous
+        // frame, which is complete by then
+        const std::size_t misalignment = (begin - m_data) % m_pageSize;
+        msync(begin - misalignment, m_frameBytes + misalignment, MS_SYNC);
+    }
+
+private:
+    std::string m_path;
+    const bool m_keep;
+    std::string m_header;
+    std::size_t m_frameBytes = 0;
+    std::size_t m_size = 0;
+    const std::size_t m_pageSize = sysconf(_SC_PAGESIZE);
+    int m_fd = -1;
+    unsigned char *m_data = 0;
+};
+
+struct ZoomTimes
+{
+    double wall = 0., compute = 0., io = 0.;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/**
+ * Zooms into seahorse valley, rendering every frame with double_v and writing it to \p stream.
+ * Pipelined, the frames are rendered into two Image buffers in turn and handed to a writer
+ * thread, so that rendering frame i + 1 overlaps with writing frame i. Otherwise rendering and
+ * writing alternate on the calling thread.
+ */
+static void zoom(PpmStream &stream, int frames, int size, bool pipelined, ZoomTimes &times)
+{
+    const DeepView target = {"zoom", -0.743643887037151, 0.131825904205330, 3., 1000};
+    auto frameView = [&](int frame) {
+        DeepView view = target;
+        view.span *= std::pow(0.8, frame);
+        return view.viewport(size);
+    };
+    const MandelOptions options = {true, true};
+    Image images[2] = {{3 * size, 2 * size}, {3 * size, 2 * size}};
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!pipelined) {
+        for (int f = 0; f < frames; ++f) {
+            auto t0 = std::chrono::steady_clock::now();
+            mandelDeep<Vc::double_v>(images[0], frameView(f), options);
+            times.compute += secondsSince(t0);
+            t0 = std::chrono::steady_clock::now();
+            stream.write(f, images[0]);
+            times.io += secondsSince(t0);
+        }
+    } else {
+        std::mutex mutex;
+        std::condition_variable changed;
+        int slots[2] = {-1, -1};  // the frame a buffer holds for the writer, or -1 if it is free
+        std::thread writer([&]() {
+            for (int f = 0; f < frames; ++f) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return slots[f % 2] == f; });
                 }
-                break;
-            case 'h':
-                usage(argv);
-                return 0;
-            case '-': // long options
-                switch (argv[i][2]) {
-                case 'h':
-                    if (std::strcmp(argv[i], "--help") == 0) {
-                        usage(argv);
-                        return 0;
-                    }
-                    usage(argv);
-                    return 1;
-                case 'o':
-                    if (std::strcmp(argv[i], "--output") == 0 && ++i < argc) {
-                        out.open(argv[i]);
-                        break;
-                    }
-                    usage(argv);
-                    return 1;
-                default:
-                    usage(argv);
-                    return 1;
+                const auto t0 = std::chrono::steady_clock::now();
+                stream.write(f, images[f % 2]);
+                times.io += secondsSince(t0);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slots[f % 2] = -1;
                 }
-            default:
-                usage(argv);
-                return 1;
+                changed.notify_all();
+            }
+        });
+        for (int f = 0; f < frames; ++f) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return slots[f % 2] == -1; });
             }
-            break;
-        default:
-            usage(argv);
-            return 1;
+            const auto t0 = std::chrono::steady_clock::now();
+            mandelDeep<Vc::double_v>(images[f % 2], frameView(f), options);
+            times.compute += secondsSince(t0);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slots[f % 2] = f;
+            }
+            changed.notify_all();
+        }
+        writer.join();
+    }
+    times.wall += secondsSince(start);
+}
+
+/**
+ * Reports sustained Frames/s and, in the "I/O hidden" column, the fraction of the time spent
+ * writing frames that did not add to the wall time, i.e. that overlapped with rendering.
+ */
+static void runZoom(int frames, int size)
+{
+    PpmStream stream(zoomOutput(), frames, 3 * size, 2 * size);
+    if (!stream.isValid()) {
+        std::cerr << "cannot create the output file for the zoom animation\n";
+        return;
+    }
+    for (bool pipelined : {false, true}) {
+        Benchmark::setColumnData("Implementation", pipelined ? "pipelined" : "serial");
+        Benchmark timer("mandelbrot (zoom animation)", frames, "Frame");
+        ZoomTimes times;
+        while (timer.wantsMoreDataPoints()) {
+            timer.Start();
+            zoom(stream, frames, size, pipelined, times);
+            timer.Stop();
         }
+        const double hidden = times.io > 0. ? (times.compute + times.io - times.wall) / times.io : 0.;
+        std::ostringstream str;
+        str << std::max(0., std::min(1., hidden));
+        Benchmark::setColumnData("I/O hidden", str.str());
+        timer.Print();
     }
+}
+#endif  // VC_BENCHMARK_HAVE_ZOOM
 
-    out << "size" << "Vc [cycles]" << "Scalar [cycles]" << "equal";
+int bmain()
+{
+    Benchmark::addColumn("size");
+    Benchmark::addColumn("Implementation");
+    Benchmark::addColumn("threads");
+    Benchmark::addColumn("tile size");
+    Benchmark::addColumn("speedup");
+    Benchmark::addColumn("equal");
+    Benchmark::addColumn("lane utilization");
+    Benchmark::addColumn("viewport");
+    Benchmark::addColumn("datatype");
+    Benchmark::addColumn("early-outs");
+    Benchmark::addColumn("Iterations/s");
+    Benchmark::addColumn("I/O hidden");
 
+    Benchmark::setColumnData("viewport", "overview");
+    Benchmark::setColumnData("datatype", "float");
+    Benchmark::setColumnData("early-outs", "none");
+    Benchmark::setColumnData("Iterations/s", "-");
+    Benchmark::setColumnData("I/O hidden", "-");
+
+    Benchmark::setColumnData("threads", "1");
+    Benchmark::setColumnData("tile size", "-");
+    Benchmark::setColumnData("speedup", "-");
     for (int size = 25; size <= 700; size += 25) {
-        out << size;
-        const float x = -2.f;
-        const float y = -1.f;
-        const float scale = 1.f / size;
-        const int maxIterations = 255;
-
-        Image imageVc{3 * size, 2 * size};
-        tsc.Start();
-        mandelMe<VcImpl>(imageVc, x, y, scale, maxIterations);
-        tsc.Stop();
-        out << tsc.Cycles();
-
-        Image imageScalar{3 * size, 2 * size};
-        tsc.Start();
-        mandelMe<ScalarImpl>(imageScalar, x, y, scale, maxIterations);
-        tsc.Stop();
-        out << tsc.Cycles();
-
-        out << (imageVc == imageScalar);
+        const View view(size);
+        std::ostringstream str;
+        str << size;
+        Benchmark::setColumnData("size", str.str());
+
+        Image imageVc{view.width, view.height};
+        mandelMe<VcImpl>(imageVc, view.x, view.y, view.scale, view.maxIterations);
+        Image imageRefill{view.width, view.height};
+        mandelMe<VcRefillImpl>(imageRefill, view.x, view.y, view.scale, view.maxIterations);
+        Image imageScalar{view.width, view.height};
+        mandelMe<ScalarImpl>(imageScalar, view.x, view.y, view.scale, view.maxIterations);
+
+        Benchmark::setColumnData("equal", imageVc == imageScalar ? "yes" : "no");
+        runSerial<VcImpl>(view);
+        Benchmark::setColumnData("equal", imageRefill == imageScalar ? "yes" : "no");
+        runSerial<VcRefillImpl>(view);
+        Benchmark::setColumnData("equal", "yes");
+        runSerial<ScalarImpl>(view);
+    }
+
+    // the same images on 1..N cores, checked against the single-threaded image
+    Benchmark::setColumnData("lane utilization", "-");
+    const int tiles = tileSize();
+    {
+        std::ostringstream str;
+        str << tiles;
+        Benchmark::setColumnData("tile size", str.str());
+    }
+    for (int size = 100; size <= 700; size += 100) {
+        const View view(size);
+        std::ostringstream str;
+        str << size;
+        Benchmark::setColumnData("size", str.str());
+        runParallel<VcImpl>(view, tiles);
+        runParallel<ScalarImpl>(view, tiles);
     }
+
+    // double precision, deep zooms and long iteration counts, with and without early-outs
+    Benchmark::setColumnData("threads", "1");
+    Benchmark::setColumnData("tile size", "-");
+    Benchmark::setColumnData("speedup", "-");
+    const int deepSize = 80;
+    {
+        std::ostringstream str;
+        str << deepSize;
+        Benchmark::setColumnData("size", str.str());
+    }
+    const DeepView deepViews[] = {
+        {"overview", -0.5, 0., 3., 1000},
+        {"seahorse valley", -0.743643887037151, 0.131825904205330, 3e-5, 10000},
+        {"deep seahorse valley", -0.743643887037151, 0.131825904205330, 3e-11, 100000},
+    };
+    const MandelOptions allOptions[] = {{false, false}, {true, false}, {false, true}, {true, true}};
+    for (const DeepView &deep : deepViews) {
+        Benchmark::setColumnData("viewport", deep.name);
+        const Viewport view = deep.viewport(deepSize);
+        Image reference{3 * deepSize, 2 * deepSize};
+        mandelDeep<double>(reference, view, {false, false});
+        for (const MandelOptions &options : allOptions) {
+            runDeep<Vc::float_v>("float_v", "Vc", view, options, reference);
+            runDeep<Vc::double_v>("double_v", "Vc", view, options, reference);
+            runDeep<Vc::SimdArray<double, Vc::float_v::size()>>("SimdArray<double, float_v::size()>",
+                                                                 "Vc", view, options, reference);
+            runDeep<float>("float", "Scalar", view, options, reference);
+            runDeep<double>("double", "Scalar", view, options, reference);
+        }
+    }
+
+#ifdef VC_BENCHMARK_HAVE_ZOOM
+    // a zoom animation, rendered and written to a PPM stream with and without overlap
+    const int zoomSize = 160;
+    const int zoomFrames = 48;
+    {
+        std::ostringstream str;
+        str << zoomSize;
+        Benchmark::setColumnData("size", str.str());
+    }
+    Benchmark::setColumnData("viewport", "zoom");
+    Benchmark::setColumnData("datatype", "double_v");
+    Benchmark::setColumnData("early-outs", earlyOutsName({true, true}));
+    Benchmark::setColumnData("Iterations/s", "-");
+    Benchmark::setColumnData("equal", "-");
+    runZoom(zoomFrames, zoomSize);
+#endif
+    return 0;
 }
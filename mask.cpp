@@ -180,9 +180,194 @@ template<typename Vector> struct CondAssignment
     }
 };
 
+/**
+ * The same conditional computation three ways: a scalar loop with a branch, Vc masked assignment
+ * (always computes all lanes), and masked assignment behind a mask.isEmpty() early exit. The
+ * selectivity of the predicate and the length of runs of equal predicate values are swept to
+ * find the points where one strategy overtakes the other.
+ */
+template<typename Vector> struct Predication
+{
+    typedef typename Vector::Mask Mask;
+    typedef typename Vector::EntryType Scalar;
+
+    enum {
+        Size = 2048, // three arrays of this size fit into L1
+        Repetitions = 256
+    };
+
+    enum Strategy {
+        Branch,
+        Masked,
+        SkipIfEmpty,
+        StrategyCount
+    };
+
+    template <typename T> static Vc_ALWAYS_INLINE T poly(T x)
+    {
+        const T a(Scalar(3));
+        const T b(Scalar(1));
+        return ((x * a + b) * x + a) * x + b;
+    }
+
+    Scalar *const m_in;
+    Scalar *const m_pred;
+    Scalar *const m_out;
+
+    Predication()
+        : m_in(Vc::malloc<Scalar, Vc::AlignOnVector>(Size)),
+          m_pred(Vc::malloc<Scalar, Vc::AlignOnVector>(Size)),
+          m_out(Vc::malloc<Scalar, Vc::AlignOnVector>(Size))
+    {
+        for (int i = 0; i < Size; i += Vector::Size) {
+            Vector::Random().store(&m_in[i], Vc::Aligned);
+        }
+        for (int i = 0; i < Size; ++i) {
+            m_in[i] = boundInput(m_in[i], std::is_integral<Scalar>());
+        }
+    }
+
+    /// |x| < 512 keeps the cubic of poly() within int: signed overflow would be UB that the
+    /// optimizer may exploit differently in the scalar branch than in the vector code
+    static Scalar boundInput(Scalar x, std::true_type) { return x % Scalar(512); }
+    static Scalar boundInput(Scalar x, std::false_type) { return x; }
+
+    ~Predication()
+    {
+        Vc::free(m_in);
+        Vc::free(m_pred);
+        Vc::free(m_out);
+    }
+
+    /**
+     * Sets the predicate to true (negative value) for the given fraction of elements. All
+     * elements of a run of \p runLength consecutive elements share the same predicate value.
+     */
+    void fillPredicate(double selectivity, int runLength)
+    {
+        unsigned int state = 0x2545f491u;
+        for (int i = 0; i < Size; i += runLength) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const bool selected = (state >> 8) < selectivity * (1u << 24);
+            for (int j = i; j < i + runLength && j < Size; ++j) {
+                m_pred[j] = selected ? Scalar(-1) : Scalar(1);
+            }
+        }
+    }
+
+    double benchmarkStrategy(Strategy strategy)
+    {
+        const Vector zero(Zero);
+        const Scalar scalarZero(0);
+        switch (strategy) {
+        case Branch:
+            benchmark_loop(Benchmark("scalar branch", Size * Repetitions, "Element")) {
+                for (int r = 0; r < Repetitions; ++r) {
+                    for (int i = 0; i < Size; ++i) {
+                        if (m_pred[i] < scalarZero) {
+                            asm volatile(""); // no if-conversion or vectorization
+                            m_out[i] = poly(m_in[i]);
+                        }
+                    }
+                }
+            }
+            break;
+        case Masked:
+            benchmark_loop(Benchmark("masked", Size * Repetitions, "Element")) {
+                for (int r = 0; r < Repetitions; ++r) {
+                    for (int i = 0; i < Size; i += Vector::Size) {
+                        const Mask mask = Vector(&m_pred[i], Vc::Aligned) < zero;
+                        Vector x(&m_out[i], Vc::Aligned);
+                        x(mask) = poly(Vector(&m_in[i], Vc::Aligned));
+                        x.store(&m_out[i], Vc::Aligned);
+                    }
+                }
+            }
+            break;
+        case SkipIfEmpty:
+            benchmark_loop(Benchmark("masked, skip if empty", Size * Repetitions, "Element")) {
+                for (int r = 0; r < Repetitions; ++r) {
+                    for (int i = 0; i < Size; i += Vector::Size) {
+                        const Mask mask = Vector(&m_pred[i], Vc::Aligned) < zero;
+                        if (!mask.isEmpty()) {
+                            Vector x(&m_out[i], Vc::Aligned);
+                            x(mask) = poly(Vector(&m_in[i], Vc::Aligned));
+                            x.store(&m_out[i], Vc::Aligned);
+                        }
+                    }
+                }
+            }
+            break;
+        case StrategyCount:
+            break;
+        }
+        return Benchmark::lastCyclesPerUnit();
+    }
+
+    static void run()
+    {
+        static const char *const strategyNames[StrategyCount] = {
+            "scalar branch", "masked", "masked, skip if empty"
+        };
+        static const double selectivities[] = { 0., .01, .1, .25, .5, .75, .9, .99, 1. };
+        static const int runLengths[] = { 1, Vector::Size, 64, 1024 };
+        enum {
+            SelectivityCount = sizeof(selectivities) / sizeof(selectivities[0])
+        };
+
+        Predication bench;
+        for (int runLength : runLengths) {
+            if (runLength == Vector::Size && Vector::Size == 1) {
+                continue;
+            }
+            std::ostringstream runLengthName;
+            runLengthName << runLength;
+            Benchmark::setColumnData("run length", runLength == 1 ? "1 (random)" : runLengthName.str());
+
+            double cycles[SelectivityCount][StrategyCount];
+            for (int s = 0; s < SelectivityCount; ++s) {
+                std::ostringstream selectivityName;
+                selectivityName << selectivities[s] * 100. << '%';
+                Benchmark::setColumnData("selectivity", selectivityName.str());
+                bench.fillPredicate(selectivities[s], runLength);
+                for (int k = 0; k < StrategyCount; ++k) {
+                    cycles[s][k] = bench.benchmarkStrategy(static_cast<Strategy>(k));
+                }
+            }
+
+            // report the selectivity at which the fastest strategy changes
+            std::cout << "Crossover points for run length " << runLengthName.str() << ":\n";
+            int previousBest = -1;
+            for (int s = 0; s < SelectivityCount; ++s) {
+                int best = 0;
+                for (int k = 1; k < StrategyCount; ++k) {
+                    if (cycles[s][k] < cycles[s][best]) {
+                        best = k;
+                    }
+                }
+                if (best != previousBest) {
+                    std::cout << "  from " << std::setw(3) << selectivities[s] * 100.
+                              << "% selectivity: " << strategyNames[best] << " ("
+                              << cycles[s][best] << " cycles/element)\n";
+                    previousBest = best;
+                }
+            }
+            std::cout << std::flush;
+        }
+        Benchmark::setColumnData("run length", "n/a");
+        Benchmark::setColumnData("selectivity", "n/a");
+    }
+};
+
 int bmain()
 {
     Benchmark::addColumn("datatype");
+    Benchmark::addColumn("selectivity");
+    Benchmark::addColumn("run length");
+    Benchmark::setColumnData("selectivity", "n/a");
+    Benchmark::setColumnData("run length", "n/a");
     Benchmark::setColumnData("datatype", "double_v");
     CondAssignment<double_v>::run();
     Benchmark::setColumnData("datatype", "float_v");
@@ -199,5 +384,12 @@ int bmain()
     Benchmark::setColumnData("datatype", "sfloat_v");
     CondAssignment<sfloat_v>::run();
 #endif
+
+    Benchmark::setColumnData("datatype", "float_v");
+    Predication<float_v>::run();
+    Benchmark::setColumnData("datatype", "double_v");
+    Predication<double_v>::run();
+    Benchmark::setColumnData("datatype", "int_v");
+    Predication<int_v>::run();
     return 0;
 }
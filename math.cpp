@@ -22,22 +22,404 @@
 #include <Vc/cpuid.h>
 
 #include <cstdlib>
+#include <limits>
 
 using namespace Vc;
 using sfloat_v = Vc::SimdArray<float, short_v::size()>;
 
+namespace Reference/*{{{*/
+{
+// long double references for the accuracy pass. Vc::round rounds to nearest even, thus nearbyint.
+static long double round(long double x) { return std::nearbyint(x); }
+static long double sqrt(long double x) { return std::sqrt(x); }
+static long double rsqrt(long double x) { return 1.L / std::sqrt(x); }
+static long double reciprocal(long double x) { return 1.L / x; }
+static long double abs(long double x) { return std::fabs(x); }
+static long double sin(long double x) { return std::sin(x); }
+static long double cos(long double x) { return std::cos(x); }
+static long double asin(long double x) { return std::asin(x); }
+static long double floor(long double x) { return std::floor(x); }
+static long double ceil(long double x) { return std::ceil(x); }
+static long double exp(long double x) { return std::exp(x); }
+static long double log(long double x) { return std::log(x); }
+static long double log2(long double x) { return std::log2(x); }
+static long double log10(long double x) { return std::log10(x); }
+static long double atan(long double x) { return std::atan(x); }
+static long double atan2(long double y, long double x) { return std::atan2(y, x); }
+static long double tan(long double x) { return std::tan(x); }
+static long double acos(long double x) { return std::acos(x); }
+static long double exp2(long double x) { return std::exp2(x); }
+static long double pow(long double x, long double y) { return std::pow(x, y); }
+} // namespace Reference/*}}}*/
+
+namespace Libm/*{{{*/
+{
+// the scalar libm functions in the precision of the benchmarked type
+template <typename T> T round(T x) { return std::nearbyint(x); }
+template <typename T> T sqrt(T x) { return std::sqrt(x); }
+template <typename T> T rsqrt(T x) { return T(1) / std::sqrt(x); }
+template <typename T> T reciprocal(T x) { return T(1) / x; }
+template <typename T> T abs(T x) { return std::abs(x); }
+template <typename T> T sin(T x) { return std::sin(x); }
+template <typename T> T cos(T x) { return std::cos(x); }
+template <typename T> T asin(T x) { return std::asin(x); }
+template <typename T> T floor(T x) { return std::floor(x); }
+template <typename T> T ceil(T x) { return std::ceil(x); }
+template <typename T> T exp(T x) { return std::exp(x); }
+template <typename T> T log(T x) { return std::log(x); }
+template <typename T> T log2(T x) { return std::log2(x); }
+template <typename T> T log10(T x) { return std::log10(x); }
+template <typename T> T atan(T x) { return std::atan(x); }
+template <typename T> T atan2(T y, T x) { return std::atan2(y, x); }
+template <typename T> T tan(T x) { return std::tan(x); }
+template <typename T> T acos(T x) { return std::acos(x); }
+template <typename T> T exp2(T x) { return std::exp2(x); }
+template <typename T> T pow(T x, T y) { return std::pow(x, y); }
+} // namespace Libm/*}}}*/
+
+namespace Composed/*{{{*/
+{
+// Vc has no tan, acos, exp2, and pow. These are the compositions of Vc functions that user code
+// has to write instead.
+template <typename V> V tan(const V &x)
+{
+    V s, c;
+    Vc::sincos(x, &s, &c);
+    return s / c;
+}
+template <typename V> V acos(const V &x)
+{
+    return V(typename V::EntryType(1.57079632679489661923)) - Vc::asin(x);
+}
+template <typename V> V exp2(const V &x)
+{
+    return Vc::exp(x * typename V::EntryType(0.693147180559945309417));
+}
+template <typename V> V pow(const V &x, const V &y)
+{
+    return Vc::exp(y * Vc::log(x));
+}
+} // namespace Composed/*}}}*/
+
+// glibc's vectorized libm (libmvec) for the vector types that map to a single register/*{{{*/
+template <typename V> struct Libmvec
+{
+    enum { Available = false };
+};
+#if defined VC_BENCHMARK_HAVE_LIBMVEC && defined __SSE2__
+extern "C" {
+__m128  _ZGVbN4v_sinf(__m128);
+__m128  _ZGVbN4v_cosf(__m128);
+__m128  _ZGVbN4v_expf(__m128);
+__m128  _ZGVbN4v_logf(__m128);
+__m128d _ZGVbN2v_sin(__m128d);
+__m128d _ZGVbN2v_cos(__m128d);
+__m128d _ZGVbN2v_exp(__m128d);
+__m128d _ZGVbN2v_log(__m128d);
+#ifdef __AVX2__
+__m256  _ZGVdN8v_sinf(__m256);
+__m256  _ZGVdN8v_cosf(__m256);
+__m256  _ZGVdN8v_expf(__m256);
+__m256  _ZGVdN8v_logf(__m256);
+__m256d _ZGVdN4v_sin(__m256d);
+__m256d _ZGVdN4v_cos(__m256d);
+__m256d _ZGVdN4v_exp(__m256d);
+__m256d _ZGVdN4v_log(__m256d);
+#define VC_LIBMVEC_AVX_F(fun) _ZGVdN8v_##fun##f
+#define VC_LIBMVEC_AVX_D(fun) _ZGVdN4v_##fun
+#elif defined __AVX__
+__m256  _ZGVcN8v_sinf(__m256);
+__m256  _ZGVcN8v_cosf(__m256);
+__m256  _ZGVcN8v_expf(__m256);
+__m256  _ZGVcN8v_logf(__m256);
+__m256d _ZGVcN4v_sin(__m256d);
+__m256d _ZGVcN4v_cos(__m256d);
+__m256d _ZGVcN4v_exp(__m256d);
+__m256d _ZGVcN4v_log(__m256d);
+#define VC_LIBMVEC_AVX_F(fun) _ZGVcN8v_##fun##f
+#define VC_LIBMVEC_AVX_D(fun) _ZGVcN4v_##fun
+#endif
+}
+
+template <> struct Libmvec<Vc::Vector<float, Vc::VectorAbi::Sse>>
+{
+    enum { Available = true };
+    typedef Vc::Vector<float, Vc::VectorAbi::Sse> V;
+    static V sin(const V &x) { return _ZGVbN4v_sinf(x.data()); }
+    static V cos(const V &x) { return _ZGVbN4v_cosf(x.data()); }
+    static V exp(const V &x) { return _ZGVbN4v_expf(x.data()); }
+    static V log(const V &x) { return _ZGVbN4v_logf(x.data()); }
+};
+template <> struct Libmvec<Vc::Vector<double, Vc::VectorAbi::Sse>>
+{
+    enum { Available = true };
+    typedef Vc::Vector<double, Vc::VectorAbi::Sse> V;
+    static V sin(const V &x) { return _ZGVbN2v_sin(x.data()); }
+    static V cos(const V &x) { return _ZGVbN2v_cos(x.data()); }
+    static V exp(const V &x) { return _ZGVbN2v_exp(x.data()); }
+    static V log(const V &x) { return _ZGVbN2v_log(x.data()); }
+};
+#ifdef __AVX__
+template <> struct Libmvec<Vc::Vector<float, Vc::VectorAbi::Avx>>
+{
+    enum { Available = true };
+    typedef Vc::Vector<float, Vc::VectorAbi::Avx> V;
+    static V sin(const V &x) { return VC_LIBMVEC_AVX_F(sin)(x.data()); }
+    static V cos(const V &x) { return VC_LIBMVEC_AVX_F(cos)(x.data()); }
+    static V exp(const V &x) { return VC_LIBMVEC_AVX_F(exp)(x.data()); }
+    static V log(const V &x) { return VC_LIBMVEC_AVX_F(log)(x.data()); }
+};
+template <> struct Libmvec<Vc::Vector<double, Vc::VectorAbi::Avx>>
+{
+    enum { Available = true };
+    typedef Vc::Vector<double, Vc::VectorAbi::Avx> V;
+    static V sin(const V &x) { return VC_LIBMVEC_AVX_D(sin)(x.data()); }
+    static V cos(const V &x) { return VC_LIBMVEC_AVX_D(cos)(x.data()); }
+    static V exp(const V &x) { return VC_LIBMVEC_AVX_D(exp)(x.data()); }
+    static V log(const V &x) { return VC_LIBMVEC_AVX_D(log)(x.data()); }
+};
+#endif
+#endif/*}}}*/
+
 template<typename Vector> struct Helper
 {
     typedef typename Vector::Mask Mask;
     typedef typename Vector::EntryType Scalar;
+    typedef std::numeric_limits<Scalar> Limits;
+    typedef long double (*Reference1)(long double);
+    typedef long double (*Reference2)(long double, long double);
 
     enum {
         Repetitions = 1024 * 1024,
-        opPerSecondFactor = Repetitions * Vector::Size
+        opPerSecondFactor = Repetitions * Vector::Size,
+        SweepSize = 1024 * 1024
+    };
+
+    struct Domain/*{{{*/
+    {
+        long double lo, hi;
+        bool logarithmic;
+        Scalar at(int i) const
+        {
+            const long double t = (i + .5L) / SweepSize;
+            return static_cast<Scalar>(logarithmic ? lo * std::pow(hi / lo, t) : lo + (hi - lo) * t);
+        }
+        Scalar shuffledAt(int i) const
+        {
+            // golden ratio sequence: pairs the inputs of binary functions quasi-randomly
+            const long double t = std::fmod((i + .5L) * 0.6180339887498948482L, 1.L);
+            return static_cast<Scalar>(lo + (hi - lo) * t);
+        }
     };
+    static Domain linear(long double lo, long double hi) { return { lo, hi, false }; }
+    static Domain logarithmic(long double lo, long double hi) { return { lo, hi, true }; }/*}}}*/
 
-    Vc_ALWAYS_INLINE void benchmarkFunction(const char *name, Vector (*fun)(const Vector &, const Vector &))/*{{{*/
+    /**
+     * Collects the ULP error of results against the long double reference and whether special
+     * inputs (±0, ±inf, NaN, denormals, ±max) produce the special results the reference does.
+     */
+    class Accuracy/*{{{*/
     {
+        double m_max = 0.;
+        double m_sum = 0.;
+        int m_count = 0;
+        int m_specialChecked = 0;
+        int m_specialWrong = 0;
+
+    public:
+        static double ulpError(Scalar r, long double ref)
+        {
+            const double inf = std::numeric_limits<double>::infinity();
+            if (std::isnan(ref)) {
+                return std::isnan(r) ? 0. : inf;
+            } else if (std::isnan(r)) {
+                return inf;
+            }
+            const long double absRef = std::fabs(ref);
+            if (absRef > Limits::max()) {
+                return (std::isinf(r) && std::signbit(r) == std::signbit(ref)) ? 0. : inf;
+            }
+            const long double ulp = absRef < Limits::min()
+                                        ? static_cast<long double>(Limits::denorm_min())
+                                        : std::ldexp(1.L, std::ilogb(absRef) - (Limits::digits - 1));
+            return static_cast<double>(std::fabs(r - ref) / ulp);
+        }
+
+        void add(Scalar r, long double ref)
+        {
+            const double err = ulpError(r, ref);
+            m_max = std::max(m_max, err);
+            m_sum += err;
+            ++m_count;
+        }
+
+        void addSpecial(Scalar r, long double ref)
+        {
+            const Scalar expected = static_cast<Scalar>(ref);
+            if (std::isnan(expected)) {
+                ++m_specialChecked;
+                m_specialWrong += !std::isnan(r);
+            } else if (std::isinf(expected) || expected == Scalar(0)) {
+                ++m_specialChecked;
+                m_specialWrong += !(r == expected && std::signbit(r) == std::signbit(expected));
+            }
+        }
+
+        void report() const
+        {
+            std::ostringstream max, mean, special;
+            max << std::setprecision(3) << m_max;
+            mean << std::setprecision(3) << m_sum / m_count;
+            special << m_specialWrong << " of " << m_specialChecked << " wrong";
+            Benchmark::setColumnData("max ULP", max.str());
+            Benchmark::setColumnData("mean ULP", mean.str());
+            Benchmark::setColumnData("special values", special.str());
+        }
+    };/*}}}*/
+
+    static const Scalar *specialValues(int *count)/*{{{*/
+    {
+        static const Scalar values[] = {
+            Scalar(0), -Scalar(0), Limits::infinity(), -Limits::infinity(), Limits::quiet_NaN(),
+            Limits::denorm_min(), -Limits::denorm_min(), Limits::min(), Limits::max(),
+            Limits::lowest(), Scalar(1), Scalar(-1)
+        };
+        *count = sizeof(values) / sizeof(values[0]);
+        return values;
+    }/*}}}*/
+
+    template <typename F> static void accuracy(F fun, Reference1 ref, const Domain &domain)/*{{{*/
+    {
+        Accuracy acc;
+        Scalar in[Vector::Size];
+        Scalar out[Vector::Size];
+        for (int i = 0; i < SweepSize; i += Vector::Size) {
+            for (std::size_t j = 0; j < Vector::Size; ++j) {
+                in[j] = domain.at(i + j);
+            }
+            fun(Vector(&in[0], Vc::Unaligned)).store(&out[0], Vc::Unaligned);
+            for (std::size_t j = 0; j < Vector::Size; ++j) {
+                acc.add(out[j], ref(in[j]));
+            }
+        }
+        int count;
+        const Scalar *specials = specialValues(&count);
+        for (int i = 0; i < count; ++i) {
+            acc.addSpecial(fun(Vector(specials[i]))[0], ref(specials[i]));
+        }
+        acc.report();
+    }
+
+    template <typename F> static void accuracy(F fun, Reference2 ref, const Domain &domain)
+    {
+        Accuracy acc;
+        Scalar in0[Vector::Size];
+        Scalar in1[Vector::Size];
+        Scalar out[Vector::Size];
+        for (int i = 0; i < SweepSize; i += Vector::Size) {
+            for (std::size_t j = 0; j < Vector::Size; ++j) {
+                in0[j] = domain.at(i + j);
+                in1[j] = domain.shuffledAt(i + j);
+            }
+            fun(Vector(&in0[0], Vc::Unaligned), Vector(&in1[0], Vc::Unaligned)).store(&out[0], Vc::Unaligned);
+            for (std::size_t j = 0; j < Vector::Size; ++j) {
+                acc.add(out[j], ref(in0[j], in1[j]));
+            }
+        }
+        int count;
+        const Scalar *specials = specialValues(&count);
+        for (int i = 0; i < count; ++i) {
+            for (int k = 0; k < count; ++k) {
+                acc.addSpecial(fun(Vector(specials[i]), Vector(specials[k]))[0],
+                               ref(specials[i], specials[k]));
+            }
+        }
+        acc.report();
+    }/*}}}*/
+
+    template <Scalar (*F)(Scalar)> static Vector libm(const Vector &x)/*{{{*/
+    {
+        Vector r;
+        for (std::size_t i = 0; i < Vector::Size; ++i) {
+            r[i] = F(x[i]);
+        }
+        return r;
+    }
+
+    template <Scalar (*F)(Scalar, Scalar)> static Vector libm2(const Vector &y, const Vector &x)
+    {
+        Vector r;
+        for (std::size_t i = 0; i < Vector::Size; ++i) {
+            r[i] = F(y[i], x[i]);
+        }
+        return r;
+    }/*}}}*/
+
+    /**
+     * Dependent chains: the result of every call feeds the input of the next call on the same
+     * chain. The transform x = a + r * zero keeps x in the input domain at the latency of a
+     * compare, a blend, a multiplication and an addition (see the "chain overhead" row): r is
+     * replaced by zero where it is not finite (e.g. log(0) or reciprocal(0)), since inf * 0 would
+     * send the rest of the chain down the NaN path. zero is hidden from the optimizer by
+     * keepResultsDirty: with -ffast-math (FAST_MATH_BENCHMARK) a + (r - r) folds to a and the
+     * chains fall apart into independent calls. With one chain the Cycles/Call column is the
+     * latency of the function, with \p K chains interleaved it approaches the reciprocal
+     * throughput.
+     */
+    template <int K, typename F> Vc_ALWAYS_INLINE void benchmarkChains(const char *name, F fun, const Vector &a)/*{{{*/
+    {
+        std::ostringstream streams;
+        streams << K;
+        Benchmark::setColumnData("mode", K == 1 ? "latency" : "throughput");
+        Benchmark::setColumnData("streams", streams.str());
+        Vector x[K];
+        Vector zero = Vector::Zero();
+        keepResultsDirty(zero);
+        benchmark_loop(Benchmark(name, double(Repetitions) * K, "Call")) {
+            for (int k = 0; k < K; ++k) {
+                x[k] = a;
+            }
+            for (int i = 0; i < Repetitions; ++i) {
+                for (int k = 0; k < K; ++k) {
+                    Vector r = fun(x[k]);
+                    r(!Vc::isfinite(r)) = zero;
+                    x[k] = a + r * zero;
+                }
+            }
+            for (int k = 0; k < K; ++k) {
+                keepResults(x[k]);
+            }
+        }
+    }
+
+    template <int K> Vc_ALWAYS_INLINE void benchmarkChains(const char *name, Vector (*fun)(const Vector &, const Vector &),
+                                                           const Vector &a, const Vector &b)
+    {
+        benchmarkChains<K>(name, [&](const Vector &x) { return fun(x, b); }, a);
+    }
+
+    template <typename... Args> Vc_ALWAYS_INLINE void benchmarkModes(const char *name, Args &&... args)
+    {
+        benchmarkChains<1>(name, args...);
+        benchmarkChains<4>(name, args...);
+        benchmarkChains<8>(name, args...);
+        Benchmark::setColumnData("mode", "independent");
+        Benchmark::setColumnData("streams", "n/a");
+    }
+
+    static Vector identity(const Vector &x) { return x; }
+    void benchmarkChainOverhead()
+    {
+        Benchmark::setColumnData("max ULP", "n/a");
+        Benchmark::setColumnData("mean ULP", "n/a");
+        Benchmark::setColumnData("special values", "n/a");
+        benchmarkModes("chain overhead", identity, Vector::Random());
+    }/*}}}*/
+
+    Vc_ALWAYS_INLINE void benchmarkFunction(const char *name, Vector (*fun)(const Vector &, const Vector &),/*{{{*/
+                                            Reference2 ref, const Domain &domain)
+    {
+        accuracy(fun, ref, domain);
         Vector a = Vector::Random();
         Vector b = Vector::Random();
         benchmark_loop(Benchmark(name, opPerSecondFactor, "Op")) {
@@ -48,10 +430,13 @@ template<typename Vector> struct Helper
                 keepResults(tmp);
             }
         }
+        benchmarkModes(name, fun, a, b);
     }
 
-    Vc_ALWAYS_INLINE void benchmarkFunction(const char *name, Vector (*fun)(const Vector &))
+    Vc_ALWAYS_INLINE void benchmarkFunction(const char *name, Vector (*fun)(const Vector &),
+                                            Reference1 ref, const Domain &domain)
     {
+        accuracy(fun, ref, domain);
         Vector a = Vector::Random();
         benchmark_loop(Benchmark(name, opPerSecondFactor, "Op")) {
             for (int i = 0; i < Repetitions; ++i) {
@@ -60,10 +445,13 @@ template<typename Vector> struct Helper
                 keepResults(tmp);
             }
         }
+        benchmarkModes(name, fun, a);
     }
 
-    Vc_ALWAYS_INLINE void benchmarkFunction(const char *name, Vector (*fun)(Vector))
+    Vc_ALWAYS_INLINE void benchmarkFunction(const char *name, Vector (*fun)(Vector),
+                                            Reference1 ref, const Domain &domain)
     {
+        accuracy(fun, ref, domain);
         Vector a = Vector::Random();
         benchmark_loop(Benchmark(name, opPerSecondFactor, "Op")) {
             for (int i = 0; i < Repetitions; ++i) {
@@ -72,38 +460,361 @@ template<typename Vector> struct Helper
                 keepResults(tmp);
             }
         }
+        benchmarkModes(name, fun, a);
+    }/*}}}*/
+
+    void runLibmvec(std::false_type) {}
+    void runLibmvec(std::true_type)/*{{{*/
+    {
+        typedef Libmvec<Vector> L;
+        benchmarkFunction("sin (libmvec)", L::sin, Reference::sin, linear(-100, 100));
+        benchmarkFunction("cos (libmvec)", L::cos, Reference::cos, linear(-100, 100));
+        benchmarkFunction("exp (libmvec)", L::exp, Reference::exp, linear(std::log(Limits::min()), std::log(Limits::max())));
+        benchmarkFunction("log (libmvec)", L::log, Reference::log, logarithmic(Limits::min(), Limits::max()));
     }/*}}}*/
 
     void run()/*{{{*/
     {
-        benchmarkFunction("round", Vc::round);
-        benchmarkFunction( "sqrt", Vc::sqrt);
-        benchmarkFunction("rsqrt", Vc::rsqrt);
-        benchmarkFunction("reciprocal", Vc::reciprocal);
-        benchmarkFunction(  "abs", Vc::abs);
-        benchmarkFunction(  "sin", Vc::sin);
-        benchmarkFunction(  "cos", Vc::cos);
-        benchmarkFunction( "asin", Vc::asin);
-        benchmarkFunction("floor", Vc::floor);
-        benchmarkFunction( "ceil", Vc::ceil);
-        benchmarkFunction(  "exp", Vc::exp);
-        benchmarkFunction(  "log", Vc::log);
-        benchmarkFunction( "log2", Vc::log2);
-        benchmarkFunction("log10", Vc::log10);
-        benchmarkFunction( "atan", Vc::atan);
-        benchmarkFunction("atan2", Vc::atan2);
+        const Domain expDomain = linear(std::log(Limits::min()), std::log(Limits::max()));
+        const Domain logDomain = logarithmic(Limits::min(), Limits::max());
+
+        benchmarkChainOverhead();
+        benchmarkFunction("round", Vc::round, Reference::round, linear(-1000, 1000));
+        benchmarkFunction( "sqrt", Vc::sqrt, Reference::sqrt, linear(0, 1000));
+        benchmarkFunction("rsqrt", Vc::rsqrt, Reference::rsqrt, linear(0, 1000));
+        benchmarkFunction("reciprocal", Vc::reciprocal, Reference::reciprocal, linear(0, 1000));
+        benchmarkFunction(  "abs", Vc::abs, Reference::abs, linear(-1000, 1000));
+        benchmarkFunction(  "sin", Vc::sin, Reference::sin, linear(-100, 100));
+        benchmarkFunction(  "cos", Vc::cos, Reference::cos, linear(-100, 100));
+        benchmarkFunction( "asin", Vc::asin, Reference::asin, linear(-1, 1));
+        benchmarkFunction("floor", Vc::floor, Reference::floor, linear(-1000, 1000));
+        benchmarkFunction( "ceil", Vc::ceil, Reference::ceil, linear(-1000, 1000));
+        benchmarkFunction(  "exp", Vc::exp, Reference::exp, expDomain);
+        benchmarkFunction(  "log", Vc::log, Reference::log, logDomain);
+        benchmarkFunction( "log2", Vc::log2, Reference::log2, logDomain);
+        benchmarkFunction("log10", Vc::log10, Reference::log10, logDomain);
+        benchmarkFunction( "atan", Vc::atan, Reference::atan, linear(-100, 100));
+        benchmarkFunction("atan2", Vc::atan2, Reference::atan2, linear(-100, 100));
+        benchmarkFunction(  "tan", Composed::tan<Vector>, Reference::tan, linear(-100, 100));
+        benchmarkFunction( "acos", Composed::acos<Vector>, Reference::acos, linear(-1, 1));
+        benchmarkFunction( "exp2", Composed::exp2<Vector>, Reference::exp2, linear(Limits::min_exponent - 1, Limits::max_exponent - 1));
+        benchmarkFunction(  "pow", Composed::pow<Vector>, Reference::pow, linear(0, 16));
+
+        benchmarkFunction("round (libm)", libm<Libm::round<Scalar>>, Reference::round, linear(-1000, 1000));
+        benchmarkFunction( "sqrt (libm)", libm<Libm::sqrt<Scalar>>, Reference::sqrt, linear(0, 1000));
+        benchmarkFunction("rsqrt (libm)", libm<Libm::rsqrt<Scalar>>, Reference::rsqrt, linear(0, 1000));
+        benchmarkFunction("reciprocal (libm)", libm<Libm::reciprocal<Scalar>>, Reference::reciprocal, linear(0, 1000));
+        benchmarkFunction(  "abs (libm)", libm<Libm::abs<Scalar>>, Reference::abs, linear(-1000, 1000));
+        benchmarkFunction(  "sin (libm)", libm<Libm::sin<Scalar>>, Reference::sin, linear(-100, 100));
+        benchmarkFunction(  "cos (libm)", libm<Libm::cos<Scalar>>, Reference::cos, linear(-100, 100));
+        benchmarkFunction( "asin (libm)", libm<Libm::asin<Scalar>>, Reference::asin, linear(-1, 1));
+        benchmarkFunction("floor (libm)", libm<Libm::floor<Scalar>>, Reference::floor, linear(-1000, 1000));
+        benchmarkFunction( "ceil (libm)", libm<Libm::ceil<Scalar>>, Reference::ceil, linear(-1000, 1000));
+        benchmarkFunction(  "exp (libm)", libm<Libm::exp<Scalar>>, Reference::exp, expDomain);
+        benchmarkFunction(  "log (libm)", libm<Libm::log<Scalar>>, Reference::log, logDomain);
+        benchmarkFunction( "log2 (libm)", libm<Libm::log2<Scalar>>, Reference::log2, logDomain);
+        benchmarkFunction("log10 (libm)", libm<Libm::log10<Scalar>>, Reference::log10, logDomain);
+        benchmarkFunction( "atan (libm)", libm<Libm::atan<Scalar>>, Reference::atan, linear(-100, 100));
+        benchmarkFunction("atan2 (libm)", libm2<Libm::atan2<Scalar>>, Reference::atan2, linear(-100, 100));
+        benchmarkFunction(  "tan (libm)", libm<Libm::tan<Scalar>>, Reference::tan, linear(-100, 100));
+        benchmarkFunction( "acos (libm)", libm<Libm::acos<Scalar>>, Reference::acos, linear(-1, 1));
+        benchmarkFunction( "exp2 (libm)", libm<Libm::exp2<Scalar>>, Reference::exp2, linear(Limits::min_exponent - 1, Limits::max_exponent - 1));
+        benchmarkFunction(  "pow (libm)", libm2<Libm::pow<Scalar>>, Reference::pow, linear(0, 16));
+
+        runLibmvec(std::integral_constant<bool, Libmvec<Vector>::Available>());
     }/*}}}*/
 };
 
+/**
+ * Applies the math functions to whole arrays: load, compute, store. The arrays sweep from L1 to
+ * main memory; the named size is the footprint of one input plus one output array.
+ */
+template<typename Vector> class ArrayStreaming/*{{{*/
+{
+    typedef typename Vector::EntryType Scalar;
+    typedef std::numeric_limits<Scalar> Limits;
+    typedef Vc::SimdArray<int, Vector::Size> IntArray;
+
+    enum InputDomain {
+        UnitInterval,
+        WideRange,
+        HugeArguments,
+        Denormals
+    };
+
+    const int m_size;
+    const int m_repetitions;
+    Scalar *m_in0;
+    Scalar *m_in1;
+    Scalar *m_addend;      // the third input of fma
+    Scalar *m_nonNegative; // |m_in0| for sqrt, rsqrt, log* and the base of pow
+    Scalar *m_bounded;     // m_in0 scaled into [-1, 1] for asin and acos
+    Scalar *m_moderate;    // m_in0 folded into [-64, 64] for exp and exp2
+    Scalar *m_unit;        // |m_bounded| in [0, 1] for the exponent of pow
+    Scalar *m_out0;
+    Scalar *m_out1;
+    int *m_exponents;
+    int *m_shifts;
+
+public:
+    static void run()
+    {
+        Benchmark::setColumnData("MemorySize", "half L1");
+        ArrayStreaming(CpuId::L1Data() / (sizeof(Scalar) * 4), 32).runDomains();
+        Benchmark::setColumnData("MemorySize", "L1");
+        ArrayStreaming(CpuId::L1Data() / (sizeof(Scalar) * 2), 32).runDomains();
+        Benchmark::setColumnData("MemorySize", "half L2");
+        ArrayStreaming(CpuId::L2Data() / (sizeof(Scalar) * 4), 8).runDomains();
+        Benchmark::setColumnData("MemorySize", "L2");
+        ArrayStreaming(CpuId::L2Data() / (sizeof(Scalar) * 2), 4).runDomains();
+        if (CpuId::L3Data() > 0) {
+            Benchmark::setColumnData("MemorySize", "half L3");
+            ArrayStreaming(CpuId::L3Data() / (sizeof(Scalar) * 4), 1).runDomains();
+            Benchmark::setColumnData("MemorySize", "L3");
+            ArrayStreaming(CpuId::L3Data() / (sizeof(Scalar) * 2), 1).runDomains();
+            Benchmark::setColumnData("MemorySize", "4x L3");
+            ArrayStreaming(CpuId::L3Data() / sizeof(Scalar) * 2, 1).runDomains();
+        } else {
+            Benchmark::setColumnData("MemorySize", "4x L2");
+            ArrayStreaming(CpuId::L2Data() / sizeof(Scalar) * 2, 1).runDomains();
+        }
+        Benchmark::setColumnData("MemorySize", "register");
+        Benchmark::setColumnData("input domain", "n/a");
+    }
+
+private:
+    ArrayStreaming(int size, int repetitions)
+        : m_size((size + Vector::Size - 1) / Vector::Size * Vector::Size),
+          m_repetitions(repetitions),
+          m_in0(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_in1(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_addend(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_nonNegative(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_bounded(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_moderate(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_unit(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_out0(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_out1(Vc::malloc<Scalar, Vc::AlignOnPage>(m_size)),
+          m_exponents(Vc::malloc<int, Vc::AlignOnPage>(m_size)),
+          m_shifts(Vc::malloc<int, Vc::AlignOnPage>(m_size))
+    {
+#ifndef VC_BENCHMARK_NO_MLOCK
+        mlock(m_in0, m_size * sizeof(Scalar));
+        mlock(m_in1, m_size * sizeof(Scalar));
+        mlock(m_addend, m_size * sizeof(Scalar));
+        mlock(m_nonNegative, m_size * sizeof(Scalar));
+        mlock(m_bounded, m_size * sizeof(Scalar));
+        mlock(m_moderate, m_size * sizeof(Scalar));
+        mlock(m_unit, m_size * sizeof(Scalar));
+        mlock(m_out0, m_size * sizeof(Scalar));
+        mlock(m_out1, m_size * sizeof(Scalar));
+#endif
+        unsigned int state = 0x9e3779b9u;
+        for (int i = 0; i < m_size; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            m_shifts[i] = static_cast<int>(state % 17) - 8;
+            m_out0[i] = m_out1[i] = Scalar(0);
+        }
+    }
+
+    ~ArrayStreaming()
+    {
+        Vc::free(m_in0);
+        Vc::free(m_in1);
+        Vc::free(m_addend);
+        Vc::free(m_nonNegative);
+        Vc::free(m_bounded);
+        Vc::free(m_moderate);
+        Vc::free(m_unit);
+        Vc::free(m_out0);
+        Vc::free(m_out1);
+        Vc::free(m_exponents);
+        Vc::free(m_shifts);
+    }
+
+    static void fill(Scalar *data, int size, InputDomain domain, unsigned int state)/*{{{*/
+    {
+        for (int i = 0; i < size; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const Scalar u = Scalar(state >> 8) * Scalar(1. / (1 << 24));  // [0, 1)
+            const Scalar sign = (state & 1) ? Scalar(-1) : Scalar(1);
+            switch (domain) {
+            case UnitInterval:
+                data[i] = u;
+                break;
+            case WideRange:
+                // uniform in the exponent: 2^-20 ... 2^20
+                data[i] = sign * std::ldexp(Scalar(1) + u, static_cast<int>(state % 41) - 20);
+                break;
+            case HugeArguments:
+                // far outside the range where the trigonometric functions reduce cheaply
+                data[i] = sign * std::ldexp(Scalar(1) + u, static_cast<int>(state % 11) +
+                                                               (sizeof(Scalar) == 4 ? 13 : 30));
+                break;
+            case Denormals:
+                data[i] = sign * u * Limits::min();
+                break;
+            }
+        }
+    }/*}}}*/
+
+    template <typename F> void stream(const char *name, F &&kernel)/*{{{*/
+    {
+        // initial pass so that the first iteration in the benchmark loop has the same cache
+        // history as subsequent runs
+        for (int i = 0; i < m_size; i += Vector::Size) {
+            kernel(i);
+        }
+        benchmark_loop(Benchmark(name, double(m_size) * m_repetitions, "Op")) {
+            for (int r = 0; r < m_repetitions; ++r) {
+                for (int i = 0; i < m_size; i += Vector::Size) {
+                    kernel(i);
+                }
+            }
+        }
+    }
+
+    template <typename F> void unary(const char *name, F fun, const Scalar *in = 0)
+    {
+        in = in ? in : m_in0;
+        stream(name, [&](int i) {
+            fun(Vector(&in[i], Vc::Aligned)).store(&m_out0[i], Vc::Aligned);
+        });
+    }
+
+    template <typename F>
+    void binary(const char *name, F fun, const Scalar *in0 = 0, const Scalar *in1 = 0)
+    {
+        in0 = in0 ? in0 : m_in0;
+        in1 = in1 ? in1 : m_in1;
+        stream(name, [&](int i) {
+            fun(Vector(&in0[i], Vc::Aligned), Vector(&in1[i], Vc::Aligned))
+                .store(&m_out0[i], Vc::Aligned);
+        });
+    }/*}}}*/
+
+    /**
+     * The inputs of the functions with a restricted domain are derived from m_in0, so that
+     * sqrt, log and friends do not spend half of the time on the NaN path for negative inputs
+     * and exp and pow do not spend it on the overflow path. Inputs above 1 are scaled by 2^-22
+     * for the bounded array, the wide range stays wide otherwise.
+     */
+    void deriveRestrictedInputs()/*{{{*/
+    {
+        for (int i = 0; i < m_size; ++i) {
+            const Scalar x = m_in0[i];
+            m_nonNegative[i] = std::abs(x);
+            m_bounded[i] = std::abs(x) <= Scalar(1) ? x : x / std::ldexp(Scalar(1), 22);
+            m_moderate[i] = std::abs(x) <= Scalar(64) ? x : std::fmod(x, Scalar(64));
+            m_unit[i] = std::abs(m_bounded[i]);
+        }
+    }/*}}}*/
+
+    void runDomains()/*{{{*/
+    {
+        Benchmark::setColumnData("input domain", "[0, 1)");
+        runDomain(UnitInterval);
+        Benchmark::setColumnData("input domain", "wide range");
+        runDomain(WideRange);
+        Benchmark::setColumnData("input domain", "huge arguments");
+        runDomain(HugeArguments);
+        Benchmark::setColumnData("input domain", "denormals");
+        runDomain(Denormals);
+    }/*}}}*/
+
+    void runDomain(InputDomain domain)/*{{{*/
+    {
+        fill(m_in0, m_size, domain, 0x2545f491u);
+        fill(m_in1, m_size, domain, 0x9b97f4a7u);
+        fill(m_addend, m_size, domain, 0x68e31da4u);
+        deriveRestrictedInputs();
+
+        unary("sin", [](const Vector &x) { return Vc::sin(x); });
+        unary("cos", [](const Vector &x) { return Vc::cos(x); });
+        unary("tan", [](const Vector &x) { return Composed::tan(x); });
+        stream("sincos", [&](int i) {
+            Vector s, c;
+            Vc::sincos(Vector(&m_in0[i], Vc::Aligned), &s, &c);
+            s.store(&m_out0[i], Vc::Aligned);
+            c.store(&m_out1[i], Vc::Aligned);
+        });
+        if (domain == HugeArguments) {
+            // only the trigonometric functions have to reduce huge arguments
+            return;
+        }
+
+        unary("round", [](const Vector &x) { return Vc::round(x); });
+        unary("sqrt", [](const Vector &x) { return Vc::sqrt(x); }, m_nonNegative);
+        unary("rsqrt", [](const Vector &x) { return Vc::rsqrt(x); }, m_nonNegative);
+        unary("reciprocal", [](const Vector &x) { return Vc::reciprocal(x); });
+        unary("abs", [](const Vector &x) { return Vc::abs(x); });
+        unary("asin", [](const Vector &x) { return Vc::asin(x); }, m_bounded);
+        unary("acos", [](const Vector &x) { return Composed::acos(x); }, m_bounded);
+        unary("floor", [](const Vector &x) { return Vc::floor(x); });
+        unary("ceil", [](const Vector &x) { return Vc::ceil(x); });
+        unary("exp", [](const Vector &x) { return Vc::exp(x); }, m_moderate);
+        unary("exp2", [](const Vector &x) { return Composed::exp2(x); }, m_moderate);
+        unary("log", [](const Vector &x) { return Vc::log(x); }, m_nonNegative);
+        unary("log2", [](const Vector &x) { return Vc::log2(x); }, m_nonNegative);
+        unary("log10", [](const Vector &x) { return Vc::log10(x); }, m_nonNegative);
+        unary("atan", [](const Vector &x) { return Vc::atan(x); });
+        binary("atan2", [](const Vector &y, const Vector &x) { return Vc::atan2(y, x); });
+        binary("pow", [](const Vector &x, const Vector &y) { return Composed::pow(x, y); },
+               m_nonNegative, m_unit);
+        stream("fma", [&](int i) {
+            const Vector a(&m_in0[i], Vc::Aligned);
+            const Vector b(&m_in1[i], Vc::Aligned);
+            const Vector c(&m_addend[i], Vc::Aligned);
+            Vc::fma(a, b, c).store(&m_out0[i], Vc::Aligned);
+        });
+        stream("frexp", [&](int i) {
+            IntArray e;
+            Vc::frexp(Vector(&m_in0[i], Vc::Aligned), &e).store(&m_out0[i], Vc::Aligned);
+            e.store(&m_exponents[i], Vc::Aligned);
+        });
+        stream("ldexp", [&](int i) {
+            Vc::ldexp(Vector(&m_in0[i], Vc::Aligned), IntArray(&m_shifts[i], Vc::Aligned))
+                .store(&m_out0[i], Vc::Aligned);
+        });
+    }/*}}}*/
+};/*}}}*/
+
 int bmain()/*{{{*/
 {
     Benchmark::addColumn("datatype");
+    Benchmark::addColumn("max ULP");
+    Benchmark::addColumn("mean ULP");
+    Benchmark::addColumn("special values");
+    Benchmark::addColumn("mode");
+    Benchmark::addColumn("streams");
+    Benchmark::setColumnData("mode", "independent");
+    Benchmark::setColumnData("streams", "n/a");
+    Benchmark::addColumn("MemorySize");
+    Benchmark::addColumn("input domain");
+    Benchmark::setColumnData("MemorySize", "register");
+    Benchmark::setColumnData("input domain", "n/a");
+
     Benchmark::setColumnData("datatype", "float_v");
     Helper<float_v>().run();
     Benchmark::setColumnData("datatype", "sfloat_v");
     Helper<sfloat_v>().run();
     Benchmark::setColumnData("datatype", "double_v");
     Helper<double_v>().run();
+
+    Benchmark::setColumnData("max ULP", "n/a");
+    Benchmark::setColumnData("mean ULP", "n/a");
+    Benchmark::setColumnData("special values", "n/a");
+    Benchmark::setColumnData("mode", "streaming");
+    Benchmark::setColumnData("datatype", "float_v");
+    ArrayStreaming<float_v>::run();
+    Benchmark::setColumnData("datatype", "sfloat_v");
+    ArrayStreaming<sfloat_v>::run();
+    Benchmark::setColumnData("datatype", "double_v");
+    ArrayStreaming<double_v>::run();
     return 0;
 }/*}}}*/
 
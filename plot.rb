@@ -23,6 +23,7 @@ class LabelTranslation #{{{
             'math' => 'Math Functions Benchmark',
             'dhryrock' => 'Dhryrock Benchmark (Integer Vectors)',
             'whetrock' => 'Whetrock Benchmark (Floating-Point Vectors)',
+            'mandelbrot' => 'Mandelbrot Benchmark',
 
             'half L1' => '⅟₂ L1',
             'half L2' => '⅟₂ L2',
@@ -206,6 +207,7 @@ $benchmarks = {
     },
     'dhryrock' => { #{{{1
         :sort => [:bars],
+        :pageColumn => ['mode', 'threads'],
         :clusterColumns => 'benchmark.name',
         :barColumns => 'Implementation',
         :dataColumn => 'Ops/Cycle',
@@ -213,10 +215,19 @@ $benchmarks = {
     },
     'whetrock' => { #{{{1
         :sort => [:bars],
+        :pageColumn => ['mode', 'threads'],
         :clusterColumns => 'benchmark.name',
         :barColumns => 'Implementation',
         :dataColumn => 'Ops/Cycle',
         :ylabel => 'Operations / Cycle'
+    },
+    'mandelbrot' => { #{{{1
+        :sort => [:bars],
+        :pageColumn => ['benchmark.name', 'threads'],
+        :clusterColumns => 'size',
+        :barColumns => 'Implementation',
+        :dataColumn => 'Pixels/Cycle',
+        :ylabel => 'Pixels / Cycle'
     } #}}}1
 }
 if $argv.include? '--help' or $argv.include? '-h'# {{{
@@ -234,7 +245,6 @@ if $argv.include? '--help' or $argv.include? '-h'# {{{
     $benchmarks.each do |b|
         puts "  #{b[0]}"
     end
-    puts "  mandelbrot"
     exit
 end# }}}
 if $argv.include? '--font'# {{{
@@ -395,6 +405,12 @@ class DataParser #{{{1
     def squaredSum(x, y)# {{{
         return Math.sqrt(x * x + y * y)
     end# }}}
+    # Version 5 files have a block of "# key\t: value" metadata lines before the column heads
+    def readColheads(dat)# {{{
+        line = dat.readline.strip
+        line = dat.readline.strip while line[0, 1] == '#'
+        return line[1..-2]
+    end# }}}
     def initialize(bench, tr, dirs = []) #{{{2
         @data = Array.new
         @colnames = Array.new
@@ -405,7 +421,7 @@ class DataParser #{{{1
                 dat = File.new(filename, "r")
                 versionline = dat.readline.strip.match /^Version (\d+)$/
                 tmp = $~[1].to_i
-                colheads = dat.readline.strip[1..-2]
+                colheads = readColheads dat
                 if @version === nil
                     @version = tmp
                     @colnames = colheads.split("\"\t\"")
@@ -427,7 +443,7 @@ class DataParser #{{{1
                 Dir.glob("#{bench}_*.dat").each do |filename|
                     dat = File.new(File.join(dirs[1], filename), "r")
                     fail unless versionline == dat.readline.strip.match(/^Version (\d+)$/)
-                    fail unless colheads == dat.readline.strip[1..-2]
+                    fail unless colheads == readColheads(dat)
                     impl = tr.translate('"' + filename[bench.length + 1..-5] + '"')
                     dat.readlines.each do |line|
                         data2.push(line.strip.split("\t").map{|x| tr.translate x} + [impl])
@@ -587,7 +603,7 @@ EOF
 # ##### MAIN: process benchmarks {{{1
 $pdfs = Array.new
 def processBenchmark(tmpdirs = [])#{{{
-    ($argv.empty? ? $benchmarks : ($argv - ['mandelbrot'])).each do |bench|#{{{
+    ($argv.empty? ? $benchmarks : $argv).each do |bench|#{{{
         if bench.is_a? Array
             opt = bench[1]
             bench = bench[0]
@@ -677,46 +693,6 @@ plot \
 EOF
         end# }}}
     end #}}}
-    if $argv.empty? or $argv.include? "mandelbrot" #{{{1
-        tr = LabelTranslation.new
-        mandeldat = Dir.glob("mandelbrot_*.dat").map { |filename| [filename, "Vc::" + tr.translate(filename["mandelbrot_".length..-5])] }
-
-        if not mandeldat.empty?
-            pdffile = 'mandelbrot.pdf'
-            $pdfs << pdffile
-
-            $gnuplot.print <<EOF
-set ytics auto
-set xtics 100
-
-set terminal pdf color enhanced font "CM Sans,5" size 16cm,9cm
-set pointsize 0.6
-set output "#{pdffile}"
-set style data linespoints
-set key left top
-
-set xlabel "width/3 = height/2 [pixels]"
-
-#set tmargin 0.3
-#set lmargin 8
-#set rmargin 2.5
-#set bmargin 3.06
-#
-#set xrange [0:700]
-
-set title "Mandelbrot Benchmark"
-set ylabel "runtime [10^9 cycles]"
-plot \\
-'#{mandeldat[0][0]}' using 1:($3/10**9) title "builtin", \\
-#{(mandeldat.map {|x| "'#{x[0]}' using 1:($2/10**9) title \"#{x[1]}\""}).join(", \\\n")}
-
-set key at -20,2.4
-set ylabel "speedup"
-plot \\
-#{(mandeldat.map {|x| "'#{x[0]}' using 1:($3/$2) title \"#{x[1]} vs. builtin\""}).join(", \\\n")}
-EOF
-        end
-    end #}}}1
     $gnuplot.close
 
     # all.pdf {{{1
@@ -0,0 +1,288 @@
+/*  This file is part of the Vc library.
+
+    Copyright (C) 2016 Matthias Kretz <kretz@kde.org>
+
+    Vc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    Vc is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Vc.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef VC_BENCHMARK_ROCK_H
+#define VC_BENCHMARK_ROCK_H
+
+#include "benchmark.h"
+#include "threads.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * The driver shared by dhryrock.cpp and whetrock.cpp. A Kernel provides
+ *   name(),
+ *   init<V>(V *mem, size_t n):       fill the state of n vectors,
+ *   compute<V>(V *mem, size_t n):    the synthetic work on the state,
+ *   opsFactor<V>(size_t n):          the number of Ops compute<V> executes,
+ * and Rock<Kernel, Vs...> runs it for every vector type in Vs: once in the original allocating
+ * mode, once on pooled buffers with init and compute timed separately, and as independent
+ * instances on 1..N pinned cores (cf. threadCountsToTest) to expose memory bandwidth contention.
+ */
+
+SET_HELP_TEXT("  --memory-size <MiB>  size of the state per vector type (default: 64)\n");
+
+extern std::vector<std::string> g_arguments;
+
+/// The size of the state per vector type in bytes, 64 MiB unless --memory-size says otherwise.
+static size_t rockMemorySize()
+{
+    static size_t size = 0;
+    if (size == 0) {
+        size = 64;
+        for (std::size_t i = 0; i + 1 < g_arguments.size(); ++i) {
+            if (g_arguments[i] == "--memory-size") {
+                size = std::max(1, std::atoi(g_arguments[i + 1].c_str()));
+            }
+        }
+        size *= 1024 * 1024;
+    }
+    return size;
+}
+
+/**
+ * Page aligned buffers that are allocated and pre-faulted once and then reused across data
+ * points, so that neither the allocator nor page faults end up in the timed region.
+ */
+class BufferPool
+{
+public:
+    BufferPool() = default;
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    ~BufferPool()
+    {
+        for (std::size_t i = 0; i < m_buffers.size(); ++i) {
+#ifndef VC_BENCHMARK_NO_MLOCK
+            munlock(m_buffers[i], m_sizes[i]);
+#endif
+            Vc::free(m_buffers[i]);
+        }
+    }
+
+    template <typename V> V *get(std::size_t slot, std::size_t bytes)
+    {
+        if (slot >= m_buffers.size()) {
+            m_buffers.resize(slot + 1, 0);
+            m_sizes.resize(slot + 1, 0);
+        }
+        if (m_sizes[slot] < bytes) {
+            if (m_buffers[slot]) {
+                Vc::free(m_buffers[slot]);
+            }
+            m_buffers[slot] = Vc::malloc<char, Vc::AlignOnPage>(bytes);
+            m_sizes[slot] = bytes;
+            std::memset(m_buffers[slot], 0, bytes);
+#ifndef VC_BENCHMARK_NO_MLOCK
+            mlock(m_buffers[slot], bytes);
+#endif
+        }
+        return reinterpret_cast<V *>(m_buffers[slot]);
+    }
+
+private:
+    std::vector<char *> m_buffers;
+    std::vector<std::size_t> m_sizes;
+};
+
+template <typename Kernel, typename... Vs> class Rock
+{
+    // braced init lists evaluate left to right, which keeps the order of Vs
+    typedef int Sequence[sizeof...(Vs) + 1];
+
+public:
+    static double opsFactor(size_t bytes)
+    {
+        double sum = 0.;
+        const Sequence order = {0, (sum += Kernel::template opsFactor<Vs>(bytes / sizeof(Vs)), 0)...};
+        (void)order;
+        return sum;
+    }
+
+    template <typename V> static void allocating(size_t bytes)
+    {
+        const size_t n = bytes / sizeof(V);
+        V *mem = new V[n];
+        Kernel::template init<V>(mem, n);
+        Kernel::template compute<V>(mem, n);
+        delete[] mem;
+    }
+
+    /// the original mode: allocation, page faults, init and compute all in the timed region
+    static void runAllocating(size_t bytes)
+    {
+        const Sequence order = {0, (allocating<Vs>(bytes), 0)...};
+        (void)order;
+    }
+
+    static void init(BufferPool &pool, size_t bytes)
+    {
+        size_t slot = 0;
+        const Sequence order = {0, (Kernel::template init<Vs>(pool.template get<Vs>(slot++, bytes), bytes / sizeof(Vs)), 0)...};
+        (void)order;
+    }
+
+    static void compute(BufferPool &pool, size_t bytes)
+    {
+        size_t slot = 0;
+        const Sequence order = {0, (Kernel::template compute<Vs>(pool.template get<Vs>(slot++, bytes), bytes / sizeof(Vs)), 0)...};
+        (void)order;
+    }
+
+    /**
+     * One part of an instance on one core: the state of \p V is copied from \p source into the
+     * single buffer of \p own, and then computed on between Start and Pause (or Stop for the
+     * last type) of \p handle. The copy is not timed. Copying instead of V::Random() keeps the
+     * instances independent of Vc's shared random state. Returns the seconds of the compute.
+     */
+    template <typename V>
+    static double instance(BufferPool &own, BufferPool &source, size_t bytes, size_t slot,
+                           ThreadedTimer::Handle &handle)
+    {
+        V *mem = own.template get<V>(0, bytes);
+        std::memcpy(mem, source.template get<V>(slot, bytes), bytes / sizeof(V) * sizeof(V));
+        handle.Start();
+        const auto t0 = std::chrono::steady_clock::now();
+        Kernel::template compute<V>(mem, bytes / sizeof(V));
+        const auto t1 = std::chrono::steady_clock::now();
+        if (slot + 1 < sizeof...(Vs)) {
+            handle.Pause();
+        } else {
+            handle.Stop();
+        }
+        return std::chrono::duration<double>(t1 - t0).count();
+    }
+
+    /**
+     * Independent instances, each with its own state of \p bytes, on 1..N pinned cores. Reports
+     * the aggregate score in the Benchmark row and the per-core score and the scaling efficiency
+     * (per-core score relative to a single instance) in the respective columns.
+     */
+    static void runThreaded(BufferPool &source, size_t bytes)
+    {
+        Benchmark::setColumnData("mode", "threaded");
+        double singleCore = 0.;
+        for (int threadCount : threadCountsToTest()) {
+            std::ostringstream str;
+            str << threadCount;
+            Benchmark::setColumnData("threads", str.str());
+
+            // allocate and fault in the state of every instance on the core it runs on
+            std::vector<BufferPool> pools(threadCount);
+            runOnPinnedThreads(threadCount, [&](int t) { pools[t].template get<char>(0, bytes); });
+
+            Benchmark timer(Kernel::name(), opsFactor(bytes) * threadCount, "Op");
+            // the compute time of every thread, for the mean over the cores
+            std::vector<double> seconds(threadCount, 0.);
+            int dataPoints = 0;
+            while (timer.wantsMoreDataPoints()) {
+                ThreadedTimer sync(timer, threadCount);
+                runOnPinnedThreads(threadCount, [&](int t) {
+                    ThreadedTimer::Handle handle(sync, t);
+                    size_t slot = 0;
+                    const Sequence order = {
+                        0, (seconds[t] += instance<Vs>(pools[t], source, bytes, slot++, handle), 0)...};
+                    (void)order;
+                });
+                ++dataPoints;
+            }
+            double sum = 0.;
+            for (int t = 0; t < threadCount; ++t) {
+                sum += seconds[t];
+            }
+            const double perCore =
+                sum > 0. ? opsFactor(bytes) * dataPoints * threadCount / sum : 0.;
+            if (threadCount == 1) {
+                singleCore = perCore;
+            }
+            str.str(std::string());
+            str << std::setprecision(4) << perCore;
+            Benchmark::setColumnData("Op/s per core", str.str());
+            str.str(std::string());
+            str << std::setprecision(3) << (singleCore > 0. ? perCore / singleCore : 0.);
+            Benchmark::setColumnData("scaling efficiency", str.str());
+            timer.Print();
+        }
+    }
+
+    static int run()
+    {
+        const size_t bytes = rockMemorySize();
+        Benchmark::addColumn("MemorySize");
+        Benchmark::addColumn("mode");
+        Benchmark::addColumn("threads");
+        Benchmark::addColumn("Op/s per core");
+        Benchmark::addColumn("scaling efficiency");
+        Benchmark::setColumnData("threads", "1");
+        Benchmark::setColumnData("Op/s per core", "-");
+        Benchmark::setColumnData("scaling efficiency", "-");
+        {
+            std::ostringstream str;
+            str << bytes / (1024 * 1024) << " MiB";
+            Benchmark::setColumnData("MemorySize", str.str());
+        }
+
+        Benchmark::setColumnData("mode", "allocating");
+        {
+            Benchmark timer(Kernel::name(), opsFactor(bytes), "Op");
+            while (timer.wantsMoreDataPoints()) {
+                timer.Start();
+                runAllocating(bytes);
+                timer.Stop();
+            }
+            timer.Print();
+        }
+
+        // init and compute on pooled, pre-faulted buffers, timed separately
+        BufferPool pool;
+        Benchmark::setColumnData("mode", "pooled");
+        init(pool, bytes);
+        {
+            Benchmark timer(std::string(Kernel::name()) + " init", double(bytes) * sizeof...(Vs), "Byte");
+            while (timer.wantsMoreDataPoints()) {
+                timer.Start();
+                init(pool, bytes);
+                timer.Stop();
+            }
+            timer.Print();
+        }
+        {
+            Benchmark timer(std::string(Kernel::name()) + " compute", opsFactor(bytes), "Op");
+            while (timer.wantsMoreDataPoints()) {
+                init(pool, bytes);
+                timer.Start();
+                compute(pool, bytes);
+                timer.Stop();
+            }
+            timer.Print();
+        }
+
+        runThreaded(pool, bytes);
+        return 0;
+    }
+};
+
+#endif // VC_BENCHMARK_ROCK_H
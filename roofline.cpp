@@ -0,0 +1,440 @@
+/*  This file is part of the Vc library.
+
+    Copyright (C) 2016 Matthias Kretz <kretz@kde.org>
+
+    Vc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    Vc is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Vc.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <Vc/Vc>
+#include "benchmark.h"
+#include <Vc/cpuid.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Vc;
+
+SET_HELP_TEXT("  --gnuplot <filename>  write the roofline plot script to the given file (default: roofline.gnuplot)\n");
+
+extern std::vector<std::string> g_arguments;
+
+/**
+ * Collects the compute and bandwidth ceilings of the machine and the measured kernels, and writes
+ * them out as a gnuplot script that renders an SVG.
+ *
+ * Performance is in FLOP/cycle, arithmetic intensity in FLOP/Byte, bandwidth in Byte/cycle.
+ */
+class Roofline/*{{{*/
+{
+public:
+    struct Ceiling {
+        std::string name;
+        double value;
+    };
+    struct Point {
+        std::string name;
+        double intensity;
+        double performance;
+        std::string memoryLevel;
+    };
+
+    void addCompute(const std::string &name, double flopPerCycle) { m_compute.push_back({name, flopPerCycle}); }
+    void addBandwidth(const std::string &name, double bytePerCycle) { m_bandwidth.push_back({name, bytePerCycle}); }
+    void addPoint(const std::string &name, double intensity, double performance, const std::string &level)
+    {
+        m_points.push_back({name, intensity, performance, level});
+    }
+
+    double attainable(const Point &p) const
+    {
+        double peak = 0.;
+        for (const auto &c : m_compute) {
+            peak = std::max(peak, c.value);
+        }
+        for (const auto &b : m_bandwidth) {
+            if (b.name == p.memoryLevel) {
+                return std::min(peak, b.value * p.intensity);
+            }
+        }
+        return peak;
+    }
+
+    void printSummary() const
+    {
+        std::cout << "\nRoofline ceilings:\n";
+        for (const auto &c : m_compute) {
+            std::cout << "  " << std::setw(28) << std::left << c.name << std::right << std::setw(10) << c.value << " FLOP/cycle\n";
+        }
+        for (const auto &b : m_bandwidth) {
+            std::cout << "  " << std::setw(28) << std::left << b.name << std::right << std::setw(10) << b.value << " Byte/cycle\n";
+        }
+        std::cout << "Kernels (FLOP/Byte, FLOP/cycle, fraction of the roof):\n";
+        for (const auto &p : m_points) {
+            std::cout << "  " << std::setw(48) << std::left << p.name << std::right << std::setw(10)
+                      << p.intensity << std::setw(10) << p.performance << std::setw(9)
+                      << std::setprecision(3) << 100. * p.performance / attainable(p) << "%\n"
+                      << std::setprecision(6);
+        }
+        std::cout << std::flush;
+    }
+
+    void writeGnuplot(const std::string &filename) const
+    {
+        std::string svg = filename;
+        const auto dot = svg.rfind('.');
+        if (dot != std::string::npos) {
+            svg.erase(dot);
+        }
+        svg += ".svg";
+
+        std::ofstream out(filename.c_str());
+        out << "set terminal svg size 1200,800 dynamic\n"
+               "set output \"" << svg << "\"\n"
+               "set title \"Roofline\"\n"
+               "set logscale xy 2\n"
+               "set xlabel \"arithmetic intensity [FLOP/Byte]\"\n"
+               "set ylabel \"performance [FLOP/cycle]\"\n"
+               "set xrange [1./64:256]\n"
+               "set key left top\n"
+               "set grid\n"
+               "min(a, b) = a < b ? a : b\n";
+        double peak = 0.;
+        for (const auto &c : m_compute) {
+            peak = std::max(peak, c.value);
+        }
+        int n = 1;
+        for (const auto &p : m_points) {
+            out << "set label " << n++ << " \"" << p.name << "\" at " << p.intensity << ','
+                << p.performance << " point pointtype 7 offset 1,0 font \",9\"\n";
+        }
+        out << "plot ";
+        const char *separator = "";
+        for (const auto &b : m_bandwidth) {
+            out << separator << "min(" << peak << ", " << b.value << " * x) title \"" << b.name
+                << " (" << b.value << " Byte/cycle)\" with lines linewidth 2";
+            separator = ", \\\n     ";
+        }
+        for (const auto &c : m_compute) {
+            out << separator << c.value << " title \"" << c.name << " (" << c.value
+                << " FLOP/cycle)\" with lines dashtype 2";
+            separator = ", \\\n     ";
+        }
+        out << '\n';
+        std::cout << "Wrote " << filename << " (run gnuplot on it to create " << svg << ")\n";
+    }
+
+private:
+    std::vector<Ceiling> m_compute;
+    std::vector<Ceiling> m_bandwidth;
+    std::vector<Point> m_points;
+};/*}}}*/
+
+static double lastPerCycle()
+{
+    const double c = Benchmark::lastCyclesPerUnit();
+    return c > 0. ? 1. / c : 0.;
+}
+
+/*
+ * The number of independent chains per operation that keeps all units busy is the latency of the
+ * instruction times the number of ports that can execute it, as in flops.cpp: 5 x 2 for FMA on
+ * Haswell/Broadwell, 4 x 2 for FMA, mul and add on Skylake.
+ */
+#ifndef VC_BENCHMARK_FMA_LATENCY
+#define VC_BENCHMARK_FMA_LATENCY 5
+#endif
+#ifndef VC_BENCHMARK_FMA_PORTS
+#define VC_BENCHMARK_FMA_PORTS 2
+#endif
+
+template <typename Vector> struct PeakCompute/*{{{*/
+{
+    enum {
+        Repetitions = 1024 * 1024,
+        Accumulators = VC_BENCHMARK_FMA_LATENCY * VC_BENCHMARK_FMA_PORTS
+    };
+
+    // separate multiply and add chains: the compiler cannot contract them into FMAs
+    static double mulAdd(const char *name)
+    {
+        Vector y = Vector(One);
+        keepResultsDirty(y);
+        Vector m[Accumulators];
+        Vector a[Accumulators];
+        benchmark_loop(Benchmark(name, 2. * Repetitions * Accumulators * Vector::Size, "FLOP")) {
+            for (int k = 0; k < Accumulators; ++k) {
+                m[k] = Vector::Random();
+                a[k] = Vector::Random();
+            }
+            benchmark_restart();
+            for (int i = 0; i < Repetitions; ++i) {
+                for (int k = 0; k < Accumulators; ++k) {
+                    m[k] = m[k] * y;
+                    a[k] = a[k] + y;
+                }
+            }
+            for (int k = 0; k < Accumulators; ++k) {
+                keepResults(m[k], a[k]);
+            }
+        }
+        return lastPerCycle();
+    }
+
+    static double fma(const char *name)
+    {
+        Vector y = Vector(One);
+        keepResultsDirty(y);
+        Vector a[Accumulators];
+        benchmark_loop(Benchmark(name, 2. * Repetitions * Accumulators * Vector::Size, "FLOP")) {
+            for (int k = 0; k < Accumulators; ++k) {
+                a[k] = Vector::Random();
+            }
+            benchmark_restart();
+            for (int i = 0; i < Repetitions; ++i) {
+                for (int k = 0; k < Accumulators; ++k) {
+                    a[k] = Vc::fma(a[k], y, y);
+                }
+            }
+            for (int k = 0; k < Accumulators; ++k) {
+                keepResults(a[k]);
+            }
+        }
+        return lastPerCycle();
+    }
+};/*}}}*/
+
+/**
+ * Read bandwidth of one level of the memory hierarchy.
+ */
+static double readBandwidth(const char *name, std::size_t bytes, int repetitions)/*{{{*/
+{
+    const int size = bytes / sizeof(float) / (4 * float_v::Size) * (4 * float_v::Size);
+    float *data = Vc::malloc<float, Vc::AlignOnPage>(size);
+    for (int i = 0; i < size; i += float_v::Size) {
+        float_v::Random().store(&data[i], Vc::Aligned);
+    }
+    benchmark_loop(Benchmark(name, double(size) * sizeof(float) * repetitions, "Byte")) {
+        float_v sum0(Zero), sum1(Zero), sum2(Zero), sum3(Zero);
+        for (int r = 0; r < repetitions; ++r) {
+            for (int i = 0; i < size; i += 4 * float_v::Size) {
+                sum0 += float_v(&data[i + 0 * float_v::Size], Vc::Aligned);
+                sum1 += float_v(&data[i + 1 * float_v::Size], Vc::Aligned);
+                sum2 += float_v(&data[i + 2 * float_v::Size], Vc::Aligned);
+                sum3 += float_v(&data[i + 3 * float_v::Size], Vc::Aligned);
+            }
+        }
+        keepResults(sum0, sum1, sum2, sum3);
+    }
+    Vc::free(data);
+    return lastPerCycle();
+}/*}}}*/
+
+/**
+ * Representative kernels of the other benchmarks of the suite, with their FLOP and Byte counts
+ * taken from the source.
+ */
+class SuiteKernels/*{{{*/
+{
+    const int m_size;
+    float *const m_a;
+    float *const m_b;
+    float *const m_out;
+    Roofline &m_roofline;
+    const std::string m_level;
+
+public:
+    SuiteKernels(Roofline &roofline, std::size_t bytes, const std::string &level)
+        : m_size(bytes / (3 * sizeof(float)) / float_v::Size * float_v::Size),
+          m_a(Vc::malloc<float, Vc::AlignOnPage>(3 * m_size)),  // 3x for the interleaved kernel
+          m_b(Vc::malloc<float, Vc::AlignOnPage>(m_size)),
+          m_out(Vc::malloc<float, Vc::AlignOnPage>(m_size)),
+          m_roofline(roofline),
+          m_level(level)
+    {
+        for (int i = 0; i < 3 * m_size; i += float_v::Size) {
+            (float_v::Random() + 1.f).store(&m_a[i], Vc::Aligned);
+        }
+        for (int i = 0; i < m_size; i += float_v::Size) {
+            (float_v::Random() + 1.f).store(&m_b[i], Vc::Aligned);
+            float_v(Zero).store(&m_out[i], Vc::Aligned);
+        }
+    }
+
+    ~SuiteKernels()
+    {
+        Vc::free(m_a);
+        Vc::free(m_b);
+        Vc::free(m_out);
+    }
+
+    template <typename F> void measure(const std::string &name, double flopPerElement, double bytePerElement, F &&kernel)
+    {
+        const std::string fullName = name + " [" + m_level + "]";
+        kernel();  // same cache history for all data points
+        benchmark_loop(Benchmark(fullName, flopPerElement * m_size, "FLOP")) {
+            kernel();
+        }
+        m_roofline.addPoint(fullName, flopPerElement / bytePerElement, lastPerCycle(), m_level);
+    }
+
+    void run()
+    {
+        // arithmetics.cpp
+        measure("arithmetics: add", 1, 3 * sizeof(float), [&]() {
+            for (int i = 0; i < m_size; i += float_v::Size) {
+                (float_v(&m_a[i], Vc::Aligned) + float_v(&m_b[i], Vc::Aligned)).store(&m_out[i], Vc::Aligned);
+            }
+        });
+        measure("arithmetics: mixed add/mul (16 Op/Element)", 16, sizeof(float), [&]() {
+            const float_v c(3.f);
+            for (int i = 0; i < m_size; i += float_v::Size) {
+                const float_v x(&m_a[i], Vc::Aligned);
+                float_v tmp = x;
+                for (int k = 0; k < 8; ++k) {
+                    tmp = tmp * x + c;
+                }
+                keepResults(tmp);
+            }
+        });
+
+        // math.cpp
+        measure("math: sqrt over arrays", 1, 2 * sizeof(float), [&]() {
+            for (int i = 0; i < m_size; i += float_v::Size) {
+                Vc::sqrt(float_v(&m_a[i], Vc::Aligned)).store(&m_out[i], Vc::Aligned);
+            }
+        });
+        measure("math: degree 8 polynomial over arrays", 16, 2 * sizeof(float), [&]() {
+            const float_v c(.5f);
+            for (int i = 0; i < m_size; i += float_v::Size) {
+                const float_v x(&m_a[i], Vc::Aligned);
+                float_v p = c;
+                for (int k = 0; k < 8; ++k) {
+                    p = p * x + c;
+                }
+                p.store(&m_out[i], Vc::Aligned);
+            }
+        });
+
+        // interleavedmemorywrapper.cpp: {x, y, z} structs, x * y + z
+        measure("interleaved: x * y + z over {x, y, z}", 2, 4 * sizeof(float), [&]() {
+            const float_v::IndexType indexes = float_v::IndexType::IndexesFromZero() * 3;
+            for (int i = 0; i < m_size; i += float_v::Size) {
+                const float_v x(&m_a[3 * i + 0], indexes);
+                const float_v y(&m_a[3 * i + 1], indexes);
+                const float_v z(&m_a[3 * i + 2], indexes);
+                (x * y + z).store(&m_out[i], Vc::Aligned);
+            }
+        });
+    }
+};/*}}}*/
+
+/**
+ * The inner loop of mandelbrot.cpp: 9 FLOP per lane and iteration (3 mul: (x + x) * y, x², y²;
+ * 4 add/sub of the recurrence, the add of the |z|² test and the add of the iteration counter),
+ * one int per pixel written.
+ */
+static void mandelbrotKernel(Roofline &roofline)/*{{{*/
+{
+    enum {
+        Width = 256,
+        Height = 256,
+        MaxIt = 255
+    };
+    std::vector<int> image(Width * Height);
+    double iterations = 0.;
+    const auto kernel = [&]() {
+        double its = 0.;
+        for (int py = 0; py < Height; ++py) {
+            const float_v cy = -1.f + py * (2.f / Height);
+            for (int px = 0; px < Width; px += float_v::Size) {
+                const float_v cx = -2.f + (float_v::IndexesFromZero() + float(px)) * (3.f / Width);
+                float_v x = cx;
+                float_v y = cy;
+                float_v x2 = x * x;
+                float_v y2 = y * y;
+                float_v n(Zero);
+                float_m active = x2 + y2 < 4.f;
+                int it = 0;
+                for (; it < MaxIt && !active.isEmpty(); ++it) {
+                    y = (x + x) * y + cy;
+                    x = x2 - y2 + cx;
+                    x2 = x * x;
+                    y2 = y * y;
+                    active &= x2 + y2 < 4.f;
+                    n(active) += 1.f;
+                }
+                its += it;
+                for (std::size_t i = 0; i < float_v::Size && px + i < Width; ++i) {
+                    image[py * Width + px + i] = static_cast<int>(n[i]);
+                }
+            }
+        }
+        iterations = its * float_v::Size;
+    };
+    kernel();
+    const double flops = 9. * iterations;
+    benchmark_loop(Benchmark("mandelbrot: z = z² + c", flops, "FLOP")) {
+        kernel();
+    }
+    roofline.addPoint("mandelbrot: z = z² + c", flops / (sizeof(int) * Width * Height),
+                      lastPerCycle(), "L1");
+}/*}}}*/
+
+int bmain()/*{{{*/
+{
+    std::string gnuplotFile = "roofline.gnuplot";
+    for (std::size_t i = 0; i + 1 < g_arguments.size(); ++i) {
+        if (g_arguments[i] == "--gnuplot") {
+            gnuplotFile = g_arguments[i + 1];
+        }
+    }
+
+    Roofline roofline;
+    Benchmark::addColumn("datatype");
+
+    Benchmark::setColumnData("datatype", "float_v");
+    roofline.addCompute("float_v mul/add", PeakCompute<float_v>::mulAdd("peak mul/add"));
+#if defined __FMA__ || defined __FMA4__
+    roofline.addCompute("float_v FMA", PeakCompute<float_v>::fma("peak fma"));
+#endif
+    Benchmark::setColumnData("datatype", "double_v");
+    roofline.addCompute("double_v mul/add", PeakCompute<double_v>::mulAdd("peak mul/add"));
+#if defined __FMA__ || defined __FMA4__
+    roofline.addCompute("double_v FMA", PeakCompute<double_v>::fma("peak fma"));
+#endif
+
+    Benchmark::setColumnData("datatype", "float_v");
+    const std::size_t l3 = CpuId::L3Data();
+    const std::size_t memory = 4 * (l3 > 0 ? l3 : CpuId::L2Data());
+    roofline.addBandwidth("L1", readBandwidth("read bandwidth L1", CpuId::L1Data() / 2, 128));
+    roofline.addBandwidth("L2", readBandwidth("read bandwidth L2", CpuId::L2Data() / 2, 32));
+    if (l3 > 0) {
+        roofline.addBandwidth("L3", readBandwidth("read bandwidth L3", l3 / 2, 2));
+    }
+    roofline.addBandwidth("memory", readBandwidth("read bandwidth memory", memory, 1));
+
+    SuiteKernels(roofline, CpuId::L1Data() / 2, "L1").run();
+    SuiteKernels(roofline, memory, "memory").run();
+    mandelbrotKernel(roofline);
+
+    roofline.printSummary();
+    roofline.writeGnuplot(gnuplotFile);
+    return 0;
+}/*}}}*/
+
+// vim: foldmethod=marker
@@ -20,8 +20,15 @@
 #include <Vc/Vc>
 #include "benchmark.h"
 #include <Vc/cpuid.h>
+#include "threads.h"
 
 #include <cstdlib>
+#include <unistd.h>
+#if __cplusplus >= 201703L && defined __has_include
+#if __has_include(<execution>)
+#include <execution>
+#endif
+#endif
 
 using namespace Vc;
 using sfloat_v = Vc::SimdArray<float, short_v::size()>;
@@ -37,6 +44,9 @@ template<typename Vector> struct Helper
 
     static void run()
     {
+        std::ostringstream str;
+        str << Vector::Size;
+        Benchmark::setColumnData("elements", str.str());
         benchmark_loop(Benchmark("Vc sort", Repetitions, "Call")) {
             Vector input = Vector::Random();
             benchmark_restart();
@@ -59,9 +69,504 @@ template<typename Vector> struct Helper
     }
 };
 
+/**
+ * Merges the two sorted vectors \p a and \p b such that \p a holds the lower and \p b the upper
+ * half of the result. The reversed \p b makes min/max produce two bitonic sequences, which are
+ * then sorted in-register.
+ */
+template <typename V> static Vc_ALWAYS_INLINE void mergeVectors(V &a, V &b)
+{
+    const V rb = b.reversed();
+    const V lo = Vc::min(a, rb);
+    const V hi = Vc::max(a, rb);
+    a = lo.sorted();
+    b = hi.sorted();
+}
+
+/**
+ * Merges the sorted ranges [a, aEnd) and [b, bEnd) into \p out, one vector at a time. The next
+ * vector is always loaded from the range with the smaller head; once that range cannot supply a
+ * full vector the remaining elements are merged with scalar code.
+ */
+template <typename V>
+static void mergeRanges(const typename V::EntryType *a, const typename V::EntryType *aEnd,
+                        const typename V::EntryType *b, const typename V::EntryType *bEnd,
+                        typename V::EntryType *out)
+{
+    typedef typename V::EntryType T;
+    if (aEnd - a >= int(V::Size) && bEnd - b >= int(V::Size)) {
+        V lo(a, Vc::Unaligned);
+        V hi(b, Vc::Unaligned);
+        a += V::Size;
+        b += V::Size;
+        for (;;) {
+            mergeVectors(lo, hi);
+            lo.store(out, Vc::Unaligned);
+            out += V::Size;
+            const bool takeA = a < aEnd && (b == bEnd || *a <= *b);
+            const T *&next = takeA ? a : b;
+            const T *nextEnd = takeA ? aEnd : bEnd;
+            if (nextEnd - next < int(V::Size)) {
+                break;
+            }
+            lo.load(next, Vc::Unaligned);
+            next += V::Size;
+        }
+        // hi holds V::Size elements that still need to be merged with the scalar tails
+        T carry[V::Size];
+        hi.store(&carry[0], Vc::Unaligned);
+        T tmp[2 * V::Size];
+        const T **shortRange = (aEnd - a < int(V::Size)) ? &a : &b;
+        const T *shortEnd = (shortRange == &a) ? aEnd : bEnd;
+        T *tmpEnd = std::merge(&carry[0], &carry[V::Size], *shortRange, shortEnd, &tmp[0]);
+        *shortRange = shortEnd;
+        const T *rest = a < aEnd ? a : b;
+        const T *restEnd = a < aEnd ? aEnd : bEnd;
+        std::merge(&tmp[0], tmpEnd, rest, restEnd, out);
+        return;
+    }
+    std::merge(a, aEnd, b, bEnd, out);
+}
+
+/**
+ * Returns the number of elements from \p a among the first \p diagonal elements of the merged
+ * sequence (merge path partitioning). Elements from \p a win ties.
+ */
+template <typename T>
+static size_t mergePathSplit(const T *a, size_t na, const T *b, size_t nb, size_t diagonal)
+{
+    size_t lo = diagonal > nb ? diagonal - nb : 0;
+    size_t hi = std::min(diagonal, na);
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (a[mid] <= b[diagonal - mid - 1]) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+template<typename Vector> struct ParallelSort
+{
+    typedef typename Vector::EntryType T;
+
+    /**
+     * Sorts [data, data + n) with vector kernels only: every vector is sorted in-register and the
+     * sorted runs are merged bottom-up with mergeRanges. \p tmp must hold \p n elements.
+     */
+    static void sortPartition(T *data, T *tmp, size_t n)
+    {
+        const size_t nVectors = n / Vector::Size * Vector::Size;
+        for (size_t i = 0; i < nVectors; i += Vector::Size) {
+            Vector(&data[i], Vc::Unaligned).sorted().store(&data[i], Vc::Unaligned);
+        }
+        std::sort(&data[nVectors], &data[n]);
+
+        T *src = data;
+        T *dst = tmp;
+        for (size_t width = Vector::Size; width < n; width *= 2) {
+            for (size_t i = 0; i < n; i += 2 * width) {
+                const size_t mid = std::min(i + width, n);
+                const size_t end = std::min(i + 2 * width, n);
+                mergeRanges<Vector>(&src[i], &src[mid], &src[mid], &src[end], &dst[i]);
+            }
+            std::swap(src, dst);
+        }
+        if (src != data) {
+            std::copy(src, src + n, data);
+        }
+    }
+
+    /**
+     * Sorts [data, data + n) on \p threadCount pinned threads: every thread sorts one partition
+     * with sortPartition, then the partitions are merged pairwise. Each pairwise merge is split
+     * among all threads with merge path partitioning, so that every thread writes the same
+     * number of elements on every level.
+     */
+    static void sort(T *data, T *tmp, size_t n, int threadCount)
+    {
+        std::vector<size_t> runs(threadCount + 1);
+        for (int t = 0; t <= threadCount; ++t) {
+            runs[t] = n * t / threadCount / Vector::Size * Vector::Size;
+        }
+        runs[threadCount] = n;
+
+        runOnPinnedThreads(threadCount, [&](int t) {
+            sortPartition(&data[runs[t]], &tmp[runs[t]], runs[t + 1] - runs[t]);
+        });
+
+        T *src = data;
+        T *dst = tmp;
+        while (runs.size() > 2) {
+            runOnPinnedThreads(threadCount, [&](int t) {
+                for (size_t r = 0; r + 1 < runs.size(); r += 2) {
+                    const size_t begin = runs[r];
+                    if (r + 2 >= runs.size()) {
+                        // odd run out: copy it over to the other buffer
+                        const size_t len = runs[r + 1] - begin;
+                        std::copy(&src[begin + len * t / threadCount],
+                                  &src[begin + len * (t + 1) / threadCount], &dst[begin + len * t / threadCount]);
+                        continue;
+                    }
+                    const T *a = &src[begin];
+                    const T *b = &src[runs[r + 1]];
+                    const size_t na = runs[r + 1] - begin;
+                    const size_t nb = runs[r + 2] - runs[r + 1];
+                    const size_t d0 = (na + nb) * t / threadCount;
+                    const size_t d1 = (na + nb) * (t + 1) / threadCount;
+                    const size_t i0 = mergePathSplit(a, na, b, nb, d0);
+                    const size_t i1 = mergePathSplit(a, na, b, nb, d1);
+                    mergeRanges<Vector>(a + i0, a + i1, b + (d0 - i0), b + (d1 - i1), &dst[begin + d0]);
+                }
+            });
+            std::vector<size_t> merged;
+            for (size_t r = 0; r < runs.size(); r += 2) {
+                merged.push_back(runs[r]);
+            }
+            if (merged.back() != n) {
+                merged.push_back(n);
+            }
+            runs.swap(merged);
+            std::swap(src, dst);
+        }
+        if (src != data) {
+            runOnPinnedThreads(threadCount, [&](int t) {
+                std::copy(&src[n * t / threadCount], &src[n * (t + 1) / threadCount],
+                          &data[n * t / threadCount]);
+            });
+        }
+    }
+
+    static void fillRandom(T *data, size_t n, int threadCount, unsigned int seed)
+    {
+        runOnPinnedThreads(threadCount, [&](int t) {
+            unsigned int state = seed * 2654435761u + t + 1;
+            for (size_t i = n * t / threadCount; i < n * (t + 1) / threadCount; ++i) {
+                // xorshift32
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                data[i] = std::is_floating_point<T>::value ? T(state * (1. / 4294967296.))
+                                                           : static_cast<T>(state);
+            }
+        });
+    }
+
+    static void run()
+    {
+        const double physicalMemory = double(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+        const int maxThreads = allowedCpus().size();
+        const size_t sizes[] = { 10000000, 100000000, 1000000000 };
+        const char *sizeNames[] = { "10M", "100M", "1G" };
+        for (int s = 0; s < 3; ++s) {
+            const size_t n = sizes[s];
+            if (2. * n * sizeof(T) > 0.5 * physicalMemory) {
+                std::cerr << "skipping " << sizeNames[s] << " elements: not enough memory\n";
+                continue;
+            }
+            Benchmark::setColumnData("elements", sizeNames[s]);
+            T *data = Vc::malloc<T, Vc::AlignOnPage>(n);
+            T *tmp = Vc::malloc<T, Vc::AlignOnPage>(n);
+            unsigned int seed = 1;
+
+            Benchmark::setColumnData("threads", "1");
+            benchmark_loop(Benchmark("std::sort", n, "Element")) {
+                fillRandom(data, n, maxThreads, ++seed);
+                benchmark_restart();
+                std::sort(&data[0], &data[n]);
+            }
+#ifdef __cpp_lib_parallel_algorithm
+            {
+                std::ostringstream str;
+                str << maxThreads;
+                Benchmark::setColumnData("threads", str.str());
+            }
+            benchmark_loop(Benchmark("std::sort(par)", n, "Element")) {
+                fillRandom(data, n, maxThreads, ++seed);
+                benchmark_restart();
+                std::sort(std::execution::par, &data[0], &data[n]);
+            }
+#endif
+            for (int threadCount : threadCountsToTest()) {
+                std::ostringstream str;
+                str << threadCount;
+                Benchmark::setColumnData("threads", str.str());
+                benchmark_loop(Benchmark("Vc parallel sort", n, "Element")) {
+                    fillRandom(data, n, maxThreads, ++seed);
+                    benchmark_restart();
+                    sort(data, tmp, n, threadCount);
+                }
+                if (!std::is_sorted(&data[0], &data[n])) {
+                    std::cerr << "Vc parallel sort failed to sort the data!\n";
+                }
+            }
+            Vc::free(tmp);
+            Vc::free(data);
+        }
+    }
+};
+
+/**
+ * Maps the entries of \p Vector to unsigned integers with the same ordering, so that radix
+ * sort can work on the bits directly.
+ */
+template <typename T> struct RadixKey;
+template <> struct RadixKey<unsigned int> {
+    static Vc_ALWAYS_INLINE uint_v encode(uint_v x) { return x; }
+    static Vc_ALWAYS_INLINE uint_v decode(uint_v x) { return x; }
+};
+template <> struct RadixKey<int> {
+    static Vc_ALWAYS_INLINE uint_v encode(uint_v x) { return x ^ uint_v(0x80000000u); }
+    static Vc_ALWAYS_INLINE uint_v decode(uint_v x) { return x ^ uint_v(0x80000000u); }
+};
+template <> struct RadixKey<float> {
+    // negative values: flip all bits; positive values: flip the sign bit
+    static Vc_ALWAYS_INLINE uint_v encode(uint_v x)
+    {
+        return x ^ ((uint_v::Zero() - (x >> 31)) | uint_v(0x80000000u));
+    }
+    static Vc_ALWAYS_INLINE uint_v decode(uint_v x)
+    {
+        return x ^ ((uint_v::Zero() - ((x >> 31) ^ uint_v(1u))) | uint_v(0x80000000u));
+    }
+};
+
+/**
+ * LSD radix sort on 32-bit keys with \p DigitBits bits per pass.
+ *
+ * The histograms for all passes are computed in a single vectorized sweep over the input: every
+ * lane counts into its own copy of the histogram (gather, increment, scatter), so that equal
+ * digits within one vector cannot collide. The scatter pass is either a direct scalar scatter or
+ * goes through one cache line sized write-combining buffer per bucket, which is flushed with
+ * vector stores.
+ */
+template <typename Vector, int DigitBits> class RadixSort
+{
+    typedef typename Vector::EntryType T;
+    typedef uint_v::IndexType I;
+    static_assert(sizeof(T) == sizeof(unsigned int), "RadixSort only supports 32-bit keys");
+
+    enum : unsigned int {
+        Passes = (32 + DigitBits - 1) / DigitBits,
+        Buckets = 1u << DigitBits,
+        DigitMask = Buckets - 1,
+        BufferEntries = 64 / sizeof(unsigned int)
+    };
+
+    size_t m_size;
+    unsigned int *m_keys;
+    unsigned int *m_tmp;
+    unsigned int *m_histogram;
+    unsigned int *m_offsets;
+    unsigned int *m_buffers;
+    unsigned int *m_bufferFill;
+
+public:
+    explicit RadixSort(size_t n)
+        : m_size(n)
+        , m_keys(Vc::malloc<unsigned int, Vc::AlignOnPage>(n))
+        , m_tmp(Vc::malloc<unsigned int, Vc::AlignOnPage>(n))
+        , m_histogram(Vc::malloc<unsigned int, Vc::AlignOnPage>(Passes * Buckets * uint_v::Size))
+        , m_offsets(Vc::malloc<unsigned int, Vc::AlignOnPage>(Buckets))
+        , m_buffers(Vc::malloc<unsigned int, Vc::AlignOnPage>(Buckets * BufferEntries))
+        , m_bufferFill(Vc::malloc<unsigned int, Vc::AlignOnPage>(Buckets))
+    {
+    }
+    ~RadixSort()
+    {
+        Vc::free(m_bufferFill);
+        Vc::free(m_buffers);
+        Vc::free(m_offsets);
+        Vc::free(m_histogram);
+        Vc::free(m_tmp);
+        Vc::free(m_keys);
+    }
+
+    template <bool WriteCombining> void sort(T *data)
+    {
+        const size_t n = m_size;
+        const size_t nVectors = n / uint_v::Size * uint_v::Size;
+        std::fill_n(m_histogram, Passes * Buckets * uint_v::Size, 0u);
+
+        // encode keys and count all digits in one sweep
+        const unsigned int *in = reinterpret_cast<const unsigned int *>(data);
+        const uint_v lanes = uint_v::IndexesFromZero();
+        const uint_v digitMask(static_cast<unsigned int>(DigitMask));
+        const uint_v laneCount(static_cast<unsigned int>(uint_v::Size));
+        for (size_t i = 0; i < nVectors; i += uint_v::Size) {
+            const uint_v k = RadixKey<T>::encode(uint_v(&in[i], Vc::Unaligned));
+            k.store(&m_keys[i], Vc::Unaligned);
+            for (unsigned int pass = 0; pass < Passes; ++pass) {
+                unsigned int *hist = &m_histogram[pass * Buckets * uint_v::Size];
+                const I idx = Vc::simd_cast<I>(((k >> (pass * DigitBits)) & digitMask) * laneCount + lanes);
+                uint_v count(hist, idx);
+                count += uint_v(1u);
+                count.scatter(hist, idx);
+            }
+        }
+        for (size_t i = nVectors; i < n; ++i) {
+            const unsigned int key = RadixKey<T>::encode(uint_v(in[i]))[0];
+            m_keys[i] = key;
+            for (unsigned int pass = 0; pass < Passes; ++pass) {
+                ++m_histogram[(pass * Buckets + ((key >> (pass * DigitBits)) & DigitMask)) * uint_v::Size];
+            }
+        }
+
+        unsigned int *src = m_keys;
+        unsigned int *dst = m_tmp;
+        for (unsigned int pass = 0; pass < Passes; ++pass) {
+            const unsigned int *hist = &m_histogram[pass * Buckets * uint_v::Size];
+            unsigned int sum = 0;
+            bool trivial = false;
+            for (unsigned int b = 0; b < Buckets; ++b) {
+                const unsigned int count = uint_v(&hist[b * uint_v::Size]).sum();
+                trivial |= (count == n);
+                m_offsets[b] = sum;
+                sum += count;
+            }
+            if (trivial) {
+                // all keys share this digit, the pass would be a plain copy
+                continue;
+            }
+            const unsigned int shift = pass * DigitBits;
+            if (WriteCombining) {
+                std::fill_n(m_bufferFill, Buckets, 0u);
+                for (size_t i = 0; i < n; ++i) {
+                    const unsigned int key = src[i];
+                    const unsigned int d = (key >> shift) & DigitMask;
+                    unsigned int *buffer = &m_buffers[d * BufferEntries];
+                    buffer[m_bufferFill[d]] = key;
+                    if (++m_bufferFill[d] == BufferEntries) {
+                        unsigned int *out = &dst[m_offsets[d]];
+                        for (unsigned int j = 0; j < BufferEntries; j += uint_v::Size) {
+                            uint_v(&buffer[j], Vc::Aligned).store(&out[j], Vc::Unaligned);
+                        }
+                        m_offsets[d] += BufferEntries;
+                        m_bufferFill[d] = 0;
+                    }
+                }
+                for (unsigned int d = 0; d < Buckets; ++d) {
+                    std::copy_n(&m_buffers[d * BufferEntries], m_bufferFill[d], &dst[m_offsets[d]]);
+                }
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    const unsigned int key = src[i];
+                    dst[m_offsets[(key >> shift) & DigitMask]++] = key;
+                }
+            }
+            std::swap(src, dst);
+        }
+
+        // decode into the original array
+        unsigned int *out = reinterpret_cast<unsigned int *>(data);
+        for (size_t i = 0; i < nVectors; i += uint_v::Size) {
+            RadixKey<T>::decode(uint_v(&src[i], Vc::Unaligned)).store(&out[i], Vc::Unaligned);
+        }
+        for (size_t i = nVectors; i < n; ++i) {
+            out[i] = RadixKey<T>::decode(uint_v(src[i]))[0];
+        }
+    }
+};
+
+template<typename Vector> struct RadixSortBenchmark
+{
+    typedef typename Vector::EntryType T;
+
+    /**
+     * Fills \p data with keys of reduced entropy by AND-ing \p andCount random numbers (cf.
+     * Thearling and Smith). andCount == 0 yields constant keys.
+     */
+    static void fillKeys(T *data, size_t n, int andCount)
+    {
+        unsigned int state = 2463534242u;
+        for (size_t i = 0; i < n; ++i) {
+            unsigned int bits = andCount == 0 ? 0x12345678u : ~0u;
+            for (int k = 0; k < andCount; ++k) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                bits &= state;
+            }
+            // avoid NaNs for float keys: convert the (signed) integer value
+            data[i] = static_cast<T>(static_cast<int>(bits));
+        }
+    }
+
+    template <int DigitBits> static void runRadix(const T *input, T *data, size_t n)
+    {
+        std::ostringstream str;
+        str << DigitBits;
+        Benchmark::setColumnData("digit bits", str.str());
+        RadixSort<Vector, DigitBits> radix(n);
+        benchmark_loop(Benchmark("radix sort (direct scatter)", n, "Element")) {
+            std::copy_n(input, n, data);
+            benchmark_restart();
+            radix.template sort<false>(data);
+        }
+        if (!std::is_sorted(&data[0], &data[n])) {
+            std::cerr << "radix sort (direct scatter) failed to sort the data!\n";
+        }
+        benchmark_loop(Benchmark("radix sort (write-combining)", n, "Element")) {
+            std::copy_n(input, n, data);
+            benchmark_restart();
+            radix.template sort<true>(data);
+        }
+        if (!std::is_sorted(&data[0], &data[n])) {
+            std::cerr << "radix sort (write-combining) failed to sort the data!\n";
+        }
+    }
+
+    static void run()
+    {
+        const size_t sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+        const char *sizeNames[] = { "1k", "10k", "100k", "1M", "10M" };
+        const int andCounts[] = { 1, 2, 3, 4, 5, 0 };
+        const char *entropyNames[] = { "32 bits", "25.9 bits", "17.4 bits", "10.8 bits", "6.4 bits", "0 bits" };
+        Benchmark::setColumnData("threads", "1");
+        for (int s = 0; s < 5; ++s) {
+            const size_t n = sizes[s];
+            Benchmark::setColumnData("elements", sizeNames[s]);
+            T *input = Vc::malloc<T, Vc::AlignOnPage>(n);
+            T *data = Vc::malloc<T, Vc::AlignOnPage>(n);
+            T *tmp = Vc::malloc<T, Vc::AlignOnPage>(n);
+            for (int e = 0; e < 6; ++e) {
+                Benchmark::setColumnData("key entropy", entropyNames[e]);
+                fillKeys(input, n, andCounts[e]);
+
+                Benchmark::setColumnData("digit bits", "none");
+                benchmark_loop(Benchmark("std::sort", n, "Element")) {
+                    std::copy_n(input, n, data);
+                    benchmark_restart();
+                    std::sort(&data[0], &data[n]);
+                }
+                benchmark_loop(Benchmark("Vc merge sort", n, "Element")) {
+                    std::copy_n(input, n, data);
+                    benchmark_restart();
+                    ParallelSort<Vector>::sortPartition(data, tmp, n);
+                }
+                runRadix< 8>(input, data, n);
+                runRadix<11>(input, data, n);
+                runRadix<16>(input, data, n);
+            }
+            Vc::free(tmp);
+            Vc::free(data);
+            Vc::free(input);
+        }
+    }
+};
+
 int bmain()
 {
     Benchmark::addColumn("datatype");
+    Benchmark::addColumn("elements");
+    Benchmark::addColumn("threads");
+    Benchmark::addColumn("digit bits");
+    Benchmark::addColumn("key entropy");
+    Benchmark::setColumnData("threads", "1");
+    Benchmark::setColumnData("digit bits", "none");
+    Benchmark::setColumnData("key entropy", "32 bits");
     Benchmark::setColumnData("datatype", "float_v" ); Helper<float_v >::run();
     Benchmark::setColumnData("datatype", "sfloat_v"); Helper<sfloat_v>::run();
     Benchmark::setColumnData("datatype", "double_v"); Helper<double_v>::run();
@@ -69,5 +574,14 @@ int bmain()
     Benchmark::setColumnData("datatype", "uint_v"  ); Helper<uint_v  >::run();
     Benchmark::setColumnData("datatype", "short_v" ); Helper<short_v >::run();
     Benchmark::setColumnData("datatype", "ushort_v"); Helper<ushort_v>::run();
+
+    Benchmark::setColumnData("datatype", "float_v" ); ParallelSort<float_v >::run();
+    Benchmark::setColumnData("datatype", "double_v"); ParallelSort<double_v>::run();
+    Benchmark::setColumnData("datatype", "int_v"   ); ParallelSort<int_v   >::run();
+    Benchmark::setColumnData("datatype", "uint_v"  ); ParallelSort<uint_v  >::run();
+
+    Benchmark::setColumnData("datatype", "float_v" ); RadixSortBenchmark<float_v >::run();
+    Benchmark::setColumnData("datatype", "int_v"   ); RadixSortBenchmark<int_v   >::run();
+    Benchmark::setColumnData("datatype", "uint_v"  ); RadixSortBenchmark<uint_v  >::run();
     return 0;
 }
@@ -0,0 +1,250 @@
+/*  This file is part of the Vc library.
+
+    Copyright (C) 2016 Matthias Kretz <kretz@kde.org>
+
+    Vc is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    Vc is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Vc.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef VC_BENCHMARK_THREADS_H
+#define VC_BENCHMARK_THREADS_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+#include "cpuset.h"
+
+static inline int hardwareThreadCount()
+{
+    const int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+/**
+ * Returns the CPUs the calling thread may run on, i.e. its affinity mask as restricted by e.g.
+ * numactl --physcpubind or the -cpu option. On systems without CPU affinity support these are
+ * simply 0..hardwareThreadCount()-1.
+ */
+static inline std::vector<int> allowedCpus()
+{
+    std::vector<int> r;
+#if !defined __APPLE__ && !defined _WIN32 && !defined _WIN64
+    cpu_set_t cpumask;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpumask) == 0) {
+        for (int cpuid = 0; cpuid < CPU_SETSIZE; ++cpuid) {
+            if (cpuIsSet(cpuid, &cpumask)) {
+                r.push_back(cpuid);
+            }
+        }
+    }
+#endif
+    if (r.empty()) {
+        for (int cpuid = 0; cpuid < hardwareThreadCount(); ++cpuid) {
+            r.push_back(cpuid);
+        }
+    }
+    return r;
+}
+
+/**
+ * Pins the calling thread to the given CPU. On systems without CPU affinity support this is a
+ * no-op (cf. the -cpu option in benchmark.cpp).
+ */
+static inline void pinCurrentThread(int cpuid)
+{
+#if !defined __APPLE__ && !defined _WIN32 && !defined _WIN64
+    cpu_set_t cpumask;
+    cpuZero(&cpumask);
+    cpuSet(cpuid, &cpumask);
+    sched_setaffinity(0, sizeof(cpu_set_t), &cpumask);
+#else
+    (void)cpuid;
+#endif
+}
+
+/**
+ * Calls \p f(threadId) on \p threadCount threads, where thread i is pinned to the i-th CPU of
+ * allowedCpus(), and returns after all of them have finished.
+ */
+template <typename F> static inline void runOnPinnedThreads(int threadCount, F &&f)
+{
+    const std::vector<int> cpus = allowedCpus();
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        const int cpuid = cpus[i % cpus.size()];
+        threads.emplace_back([&f, i, cpuid]() {
+            pinCurrentThread(cpuid);
+            f(i);
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/**
+ * Calls \p f(task, threadId) for every task in [0, taskCount) on \p threadCount pinned threads.
+ * Every thread starts out with an equal, contiguous range of tasks and takes tasks from its
+ * front. A thread that runs out steals the back half of the range of another thread, so that
+ * the load evens out even if the cost per task is very irregular.
+ */
+template <typename F> static inline void runWorkStealing(int threadCount, int taskCount, F &&f)
+{
+    // [begin, end) packed into one word, so that taking from the front and stealing from the
+    // back are a single CAS each
+    struct alignas(64) Range {
+        std::atomic<unsigned long long> r;
+    };
+    auto pack = [](unsigned long long b, unsigned long long e) { return b | (e << 32); };
+    std::vector<Range> ranges(threadCount);
+    for (int t = 0; t < threadCount; ++t) {
+        ranges[t].r.store(pack(static_cast<unsigned long long>(taskCount) * t / threadCount,
+                               static_cast<unsigned long long>(taskCount) * (t + 1) / threadCount));
+    }
+    runOnPinnedThreads(threadCount, [&](int id) {
+        std::atomic<unsigned long long> &own = ranges[id].r;
+        for (;;) {
+            unsigned long long r = own.load();
+            const unsigned long long b = r & 0xffffffffu;
+            if (b < (r >> 32)) {
+                if (own.compare_exchange_weak(r, r + 1)) {
+                    f(static_cast<int>(b), id);
+                }
+                continue;
+            }
+            bool stolen = false;
+            for (int i = 1; i < threadCount && !stolen; ++i) {
+                std::atomic<unsigned long long> &victim = ranges[(id + i) % threadCount].r;
+                unsigned long long v = victim.load();
+                for (;;) {
+                    const unsigned long long vb = v & 0xffffffffu;
+                    const unsigned long long ve = v >> 32;
+                    if (vb >= ve) {
+                        break;
+                    }
+                    const unsigned long long mid = ve - (ve - vb + 1) / 2;
+                    if (victim.compare_exchange_weak(v, pack(vb, mid))) {
+                        // nobody steals from an empty range, so a plain store suffices
+                        own.store(pack(mid, ve));
+                        stolen = true;
+                        break;
+                    }
+                }
+            }
+            if (!stolen) {
+                return;
+            }
+        }
+    });
+}
+
+/**
+ * Returns the list of thread counts to test for a scaling benchmark: powers of two up to the
+ * number of allowed CPUs, plus the number of allowed CPUs itself. With a single allowed CPU (e.g.
+ * -cpu <id>) this is just a single-threaded run.
+ */
+static inline std::vector<int> threadCountsToTest()
+{
+    const int max = allowedCpus().size();
+    std::vector<int> r;
+    for (int n = 1; n < max; n *= 2) {
+        r.push_back(n);
+    }
+    r.push_back(max);
+    return r;
+}
+
+/**
+ * Takes the place of the Benchmark object inside the kernels if they run on several threads at
+ * once: Start() releases all threads together and starts the clock, Stop() stops it when the
+ * last thread is done. Thread 0 drives the Benchmark object.
+ *
+ * A data point may consist of several timed segments: Pause() ends a segment like Stop() does and
+ * the next Start() resumes the clock. The other threads return from Pause() only after the clock
+ * is paused, so that whatever they do between the segments does not overlap with the timed work
+ * of slower threads.
+ */
+class ThreadedTimer
+{
+public:
+    class Handle
+    {
+    public:
+        Handle(ThreadedTimer &parent, int id) : m_parent(parent), m_id(id), m_segment(0) {}
+        void Start() { m_parent.start(m_id, m_segment); }
+        void Pause() { m_parent.stop(m_id, m_segment++, false); }
+        void Stop() { m_parent.stop(m_id, m_segment, true); }
+
+    private:
+        ThreadedTimer &m_parent;
+        const int m_id;
+        int m_segment;
+    };
+
+    ThreadedTimer(Benchmark &timer, int threadCount)
+        : m_timer(timer), m_threadCount(threadCount), m_arrived(0), m_finished(0), m_started(0),
+          m_paused(0)
+    {
+    }
+
+private:
+    // the counters only grow, segment s is complete when they reach (s + 1) per thread
+    void start(int id, int segment)
+    {
+        if (id == 0) {
+            while (m_arrived.load() != (m_threadCount - 1) * (segment + 1)) {
+            }
+            if (segment == 0) {
+                m_timer.Start();
+            } else {
+                m_timer.Resume();
+            }
+            m_started.store(segment + 1);
+        } else {
+            ++m_arrived;
+            while (m_started.load() <= segment) {
+            }
+        }
+    }
+    void stop(int id, int segment, bool last)
+    {
+        if (id == 0) {
+            while (m_finished.load() != (m_threadCount - 1) * (segment + 1)) {
+            }
+            if (last) {
+                m_timer.Stop();
+            } else {
+                m_timer.Pause();
+                m_paused.store(segment + 1);
+            }
+        } else {
+            ++m_finished;
+            if (!last) {
+                while (m_paused.load() <= segment) {
+                }
+            }
+        }
+    }
+
+    Benchmark &m_timer;
+    const int m_threadCount;
+    std::atomic<int> m_arrived;
+    std::atomic<int> m_finished;
+    std::atomic<int> m_started;
+    std::atomic<int> m_paused;
+};
+
+#endif // VC_BENCHMARK_THREADS_H
@@ -19,81 +19,69 @@
 
 #include <Vc/Vc>
 #include "benchmark.h"
+#include "rock.h"
 #include <limits>
 
 using namespace Vc;
 
-enum {
-    MemorySize = 1024 * 1024 * 64 // 64 MiB
-};
-
 void *blackHolePtr = 0;
 
-template<typename V>
-static void doBlah()
+struct WhetRock
 {
-    typedef typename V::EntryType T;
-    typedef typename V::IndexType I;
-    typedef typename V::Mask M;
-    typedef typename I::Mask IM;
+    static const char *name() { return "WhetRock"; }
 
-    const T two = 2;
-    const T divider = std::numeric_limits<T>::max() / 1500;
-    const T bound = 1000;
-
-    enum {
-        ArraySize = MemorySize / sizeof(V)
-    };
-    union {
-        V *v;
-        T *t;
-    } mem = { new V[ArraySize] };
-    for (int i = 0; i < ArraySize; ++i) {
-        mem.v[i] = V::Random();
-    }
-    V t = mem.v[0];
-    mem.v[0].setZero();
-    for (int i = 1; i < ArraySize; ++i) {
-        t = Vc::abs(t * mem.v[i] + t) / divider;
-        t(t >= bound) = two;
-        mem.v[i] = t;
-        t(t == 0) += V(One);
-    }
-    IM mask;
-    T data[1000];
-    for (I i(Vc::Zero); !(mask = i < 1000).isEmpty(); i += V::Size) {
-        M mask2(mask);
-        I i2 = static_cast<I>(V(mem.t, i, mask2));
-        V v(data, i2, mask2);
-        v = v * two + t;
-        v.scatter(data, i2, mask2);
+    template <typename V> static void init(V *mem, size_t arraySize)
+    {
+        for (size_t i = 0; i < arraySize; ++i) {
+            mem[i] = V::Random();
+        }
     }
+
+    template <typename V> static void compute(V *memV, size_t arraySize)
+    {
+        typedef typename V::EntryType T;
+        typedef typename V::IndexType I;
+        typedef typename V::Mask M;
+        typedef typename I::Mask IM;
+
+        const T two = 2;
+        const T divider = std::numeric_limits<T>::max() / 1500;
+        const T bound = 1000;
+
+        union {
+            V *v;
+            T *t;
+        } mem = { memV };
+        V t = mem.v[0];
+        mem.v[0].setZero();
+        for (size_t i = 1; i < arraySize; ++i) {
+            t = Vc::abs(t * mem.v[i] + t) / divider;
+            t(t >= bound) = two;
+            mem.v[i] = t;
+            t(t == 0) += V(One);
+        }
+        IM mask;
+        T data[1000];
+        for (I i(Vc::Zero); !(mask = i < 1000).isEmpty(); i += V::Size) {
+            M mask2(mask);
+            I i2 = static_cast<I>(V(mem.t, i, mask2));
+            V v(data, i2, mask2);
+            v = v * two + t;
+            v.scatter(data, i2, mask2);
+        }
 #ifdef __GNUC__
-    asm volatile(""::"m"(data[0]));
+        asm volatile(""::"m"(data[0]));
 #endif
-    blackHolePtr = mem.v;
-}
+        blackHolePtr = mem.v;
+    }
 
-template<typename V>
-static double opsFactor()
-{
-    enum {
-        ArraySize = MemorySize / sizeof(V)
-    };
-    return V::Size * (ArraySize * (5 + 9) + (1000 + V::Size - 1) / V::Size * 5);
-}
+    template <typename V> static double opsFactor(size_t arraySize)
+    {
+        return V::Size * (arraySize * (5 + 9) + (1000 + V::Size - 1) / V::Size * 5);
+    }
+};
 
 int bmain()
 {
-    Benchmark timer("WhetRock", opsFactor<float_v>() + opsFactor<double_v>(), "Op");
-    while (timer.wantsMoreDataPoints()) {
-        timer.Start();
-        doBlah<float_v>();
-        delete[] static_cast<float_v *>(blackHolePtr);
-        doBlah<double_v>();
-        delete[] static_cast<double_v *>(blackHolePtr);
-        timer.Stop();
-    }
-    timer.Print();
-    return 0;
+    return Rock<WhetRock, float_v, double_v>::run();
 }